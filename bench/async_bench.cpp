@@ -0,0 +1,145 @@
+#include "harness.hpp"
+#include "lbind.hpp"
+#include "binddsl.hpp"
+
+#include <chrono>
+
+using namespace lbind;
+using namespace lbind::Bench;
+
+namespace
+{
+	//Calls per coroutine, so that spawning it does not dominate.
+	const size_t calls = 1000;
+
+	EventLoop * loop = nullptr;
+
+	int increment(int n)
+	{
+		return n + 1;
+	}
+
+	Async<int> incrementReady(int n)
+	{
+		Async<int> result;
+		result.resolve(n + 1);
+		return result;
+	}
+
+	//Completed by the loop on its next turn, which is the least a real completion costs.
+	Async<int> incrementPosted(int n)
+	{
+		Async<int> result;
+		loop->post([result, n]() { result.resolve(n + 1); });
+		return result;
+	}
+
+	Async<int> incrementTimer(int n)
+	{
+		Async<int> result;
+		loop->after(std::chrono::microseconds(0), [result, n]() { result.resolve(n + 1); });
+		return result;
+	}
+
+	int yielding(lua_State * state)
+	{
+		return lua_yield(state, 0);
+	}
+
+	struct AsyncState : BenchState
+	{
+		AsyncState()
+			:events(state, std::chrono::microseconds(1))
+		{
+			module(state)
+				.def("increment", increment)
+				.def("increment_ready", incrementReady)
+				.def("increment_posted", incrementPosted)
+				.def("increment_timer", incrementTimer)
+			.end();
+
+			lua_register(state, "yielding", yielding);
+			loop = &events;
+		}
+
+		~AsyncState()
+		{
+			loop = nullptr;
+		}
+
+		//Runs body calls times in a new coroutine, until it finishes.
+		void spawn(const char * body)
+		{
+			std::string script = std::string("return function(n) local x = 0 for i = 1, n do ") + body + " end result = x end";
+			Object f = compile(state, script.c_str());
+			function = call<Object>(f);
+		}
+
+		void operator()()
+		{
+			events.spawn(function, calls);
+			events.run();
+			check(cast<int>(globals(state)["result"]) >= 0, "the coroutine finished");
+		}
+
+		EventLoop events;
+		Object function;
+	};
+}
+
+/*
+	What suspending a coroutine on an Async costs, against the bound call it would otherwise be.
+	Each operation is one call made from a coroutine the loop runs:
+
+		call            a plain bound function
+		ready async     an Async completed before it is returned, so nothing yields
+		yield           coroutine.yield from a C function, resumed by the loop next turn
+		pending async   an Async completed through post, suspending and resuming the coroutine
+		timer async     the same, completed by a timer one tick away
+*/
+LBIND_BENCHMARK(async_suspend)
+{
+	AsyncState s;
+
+	s.spawn("x = increment(x)");
+	group.run("call", 100, calls, s);
+
+	s.spawn("x = increment_ready(x)");
+	group.run("ready async", 100, calls, s);
+
+	s.spawn("yielding() x = x + 1");
+	group.run("yield", 100, calls, s);
+
+	s.spawn("x = increment_posted(x)");
+	group.run("pending async", 100, calls, s);
+
+	s.spawn("x = increment_timer(x)");
+	group.run("timer async", 1, calls, s);
+}
+
+/*
+	Starting a coroutine per request, running a short handler in it, and dropping it. The raw run
+	creates a thread every time and leaves it to the collector; the pooled one reuses one.
+*/
+LBIND_BENCHMARK(coroutine_startup)
+{
+	BenchState s;
+	s.run("function handle(n) return n + 1 end");
+	Object handle = globals(s.state)["handle"];
+
+	group.run("lua_newthread", 100 * 1000, [&]() {
+		lua_State * thread = lua_newthread(s.state);
+		Convert<Object>::to(thread, handle);
+		lua_pushinteger(thread, 1);
+
+		int results = 0;
+		check(lua_resume(thread, s.state, 1, &results) == LUA_OK, "the handler returned");
+		lua_pop(s.state, 1);
+	});
+
+	CoroutinePool pool(s.state);
+	group.run("pooled", 100 * 1000, [&]() {
+		PooledCoroutine co = pool.acquire();
+		check(co.start(handle, 1) == LUA_OK, "the handler returned");
+	});
+}
@@ -0,0 +1,133 @@
+#include "harness.hpp"
+#include "workloads.hpp"
+
+#include <string>
+
+using namespace lbind::Bench;
+
+namespace
+{
+	//Calls per script run, so that the pcall into the script does not dominate.
+	const size_t calls = 1000;
+
+	//Compiles a chunk that loops over body, and returns a runner that calls it.
+	struct Loop
+	{
+		Loop(BenchState& s, const std::string& setup, const std::string& body)
+			:state(s.state)
+		{
+			s.run(setup);
+			std::string script = "local n = ... for i = 1, n do " + body + " end";
+			check(luaL_loadstring(state, script.c_str()) == LUA_OK, "the loop compiles");
+			ref = luaL_ref(state, LUA_REGISTRYINDEX);
+		}
+
+		~Loop()
+		{
+			luaL_unref(state, LUA_REGISTRYINDEX, ref);
+		}
+
+		void operator()()
+		{
+			lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+			lua_pushinteger(state, static_cast<lua_Integer>(calls));
+			check(lua_pcall(state, 1, 0, 0) == LUA_OK, "the loop runs");
+		}
+
+		lua_State * state;
+		int ref;
+	};
+}
+
+LBIND_BENCHMARK(free_functions)
+{
+	BenchState s;
+	registerBindings(s.state);
+
+	Loop raw(s, "a = 0", "a = add_raw(a, 1)");
+	group.run("lua_CFunction", 1000, calls, raw);
+
+	Loop bound(s, "a = 0", "a = add_i(a, 1)");
+	group.run("def", 1000, calls, bound);
+
+	Loop pointer(s, "o = Int(0)", "add(o, 1)");
+	group.run("def(T *)", 1000, calls, pointer);
+}
+
+LBIND_BENCHMARK(overloads)
+{
+	BenchState s;
+	registerBindings(s.state);
+
+	Loop rawInt(s, "a = 0", "a = add_overloaded_raw(a, 1)");
+	group.run("lua_CFunction int", 1000, calls, rawInt);
+
+	Loop rawString(s, "a = 'x'", "add_overloaded_raw(a, 'y')");
+	group.run("lua_CFunction string", 1000, calls, rawString);
+
+	//The int overload is first, so it is the cheapest to reach.
+	Loop boundInt(s, "a = 0", "a = add_o(a, 1)");
+	group.run("overload int", 1000, calls, boundInt);
+
+	Loop boundString(s, "a = 'x'", "add_o(a, 'y')");
+	group.run("overload string", 1000, calls, boundString);
+}
+
+LBIND_BENCHMARK(methods)
+{
+	BenchState s;
+	registerBindings(s.state);
+
+	Loop raw(s, "r = RawInt(0)", "r:add(1)");
+	group.run("lua_CFunction", 1000, calls, raw);
+
+	Loop bound(s, "o = Int(0)", "o:addnr(1)");
+	group.run("def", 1000, calls, bound);
+
+	Loop self(s, "o = Int(0)", "o:add(1)");
+	group.run("def returns_self", 1000, calls, self);
+}
+
+LBIND_BENCHMARK(properties)
+{
+	BenchState s;
+	registerBindings(s.state);
+
+	Loop rawRead(s, "r = RawInt(0) x = 0", "x = r.value");
+	group.run("__index read", 1000, calls, rawRead);
+
+	Loop rawWrite(s, "r = RawInt(0)", "r.value = i");
+	group.run("__newindex write", 1000, calls, rawWrite);
+
+	Loop boundRead(s, "o = Int(0) x = 0", "x = o.value");
+	group.run("def_readwrite read", 1000, calls, boundRead);
+
+	Loop boundWrite(s, "o = Int(0)", "o.value = i");
+	group.run("def_readwrite write", 1000, calls, boundWrite);
+}
+
+LBIND_BENCHMARK(constructors)
+{
+	BenchState s;
+	registerBindings(s.state);
+
+	//Includes collecting what was created.
+	Loop raw(s, "", "local r = RawInt(i)");
+	group.run("lua_newuserdatauv", 100, calls, raw);
+
+	Loop bound(s, "", "local o = Int(i)");
+	group.run("constructor", 100, calls, bound);
+}
+
+LBIND_BENCHMARK(performance_difference)
+{
+	BenchState s;
+	registerBindings(s.state);
+
+	for (const Workload& w : scriptWorkloads())
+	{
+		group.run(w.name, 1, scriptWorkloadCalls, [&]() {
+			s.run(w.script);
+		});
+	}
+}
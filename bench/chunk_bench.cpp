@@ -0,0 +1,111 @@
+#include "harness.hpp"
+#include "lbind.hpp"
+
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+
+using namespace lbind;
+using namespace lbind::Bench;
+
+LBIND_BENCHMARK(chunk_vs_string)
+{
+	BenchState s;
+	std::string script = "a = 1; return a + 1";
+
+	group.run("dostring", 10 * 1000, [&]() {
+		luaL_dostring(s.state, script.c_str());
+		lua_Integer a = lua_tointeger(s.state, -1);
+		lua_pop(s.state, 1);
+		keep(a);
+	});
+
+	luaL_loadstring(s.state, script.c_str());
+	group.run("dochunk", 10 * 1000, [&]() {
+		lua_pushvalue(s.state, -1);
+		lua_pcall(s.state, 0, 1, 0);
+		lua_Integer a = lua_tointeger(s.state, -1);
+		lua_pop(s.state, 1);
+		keep(a);
+	});
+
+	lua_pop(s.state, 1);
+
+	Object fn = compile(s.state, script.c_str());
+	group.run("doobject", 10 * 1000, [&]() {
+		keep(call<int>(fn));
+	});
+
+	ChunkCache cache;
+	group.run("cached chunk", 10 * 1000, [&]() {
+		keep(call<int>(cache.load(s.state, script)));
+	});
+}
+
+LBIND_BENCHMARK(chunk_cache_startup)
+{
+	//Something closer to a real script than a single statement.
+	std::string script;
+	for (int i = 0; i < 200; ++i)
+	{
+		script += fmt::format("function handler_{0}(e) if e.kind == {0} then return e.value * 2 + {0} end return nil end\n", i);
+	}
+
+	//Starting a fresh state per iteration, as a worker would at startup.
+	auto fresh = [](auto&& cb) {
+		lua_State * state = luaL_newstate();
+		lbind::open(state);
+		cb(state);
+		lbind::close(state);
+		lua_close(state);
+	};
+
+	group.run("luaL_loadstring", 100, [&]() {
+		fresh([&](lua_State * state) {
+			Object chunk = compile(state, script.c_str());
+		});
+	});
+
+	ChunkCache cache;
+	group.run("ChunkCache", 100, [&]() {
+		fresh([&](lua_State * state) {
+			Object chunk = cache.load(state, script, "=handlers");
+		});
+	});
+}
+
+LBIND_BENCHMARK(parallel_compile)
+{
+	BenchState s;
+
+	//Generated data files, which are large and slow to parse.
+	std::vector<Script> scripts;
+	for (int i = 0; i < 64; ++i)
+	{
+		std::string source = "return {";
+		for (int j = 0; j < 2000; ++j)
+		{
+			source += fmt::format("{{ id = {0}, name = 'entry{0}', weight = {1}.5 }},", j, i);
+		}
+
+		source += "}";
+		scripts.push_back(Script{ fmt::format("=data{}", i), source });
+	}
+
+	group.run("luaL_loadbuffer", 1, scripts.size(), [&]() {
+		for (auto& script : scripts)
+		{
+			luaL_loadbuffer(s.state, script.source.data(), script.source.size(), script.name.c_str());
+			Object chunk = Object::fromStack(s.state, -1);
+			lua_pop(s.state, 1);
+		}
+	});
+
+	group.run("compileParallel(1)", 1, scripts.size(), [&]() {
+		compileParallel(s.state, scripts, 1);
+	});
+
+	group.run("compileParallel", 1, scripts.size(), [&]() {
+		compileParallel(s.state, scripts);
+	});
+}
@@ -0,0 +1,531 @@
+#include "harness.hpp"
+#include "lbind.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <fmt/format.h>
+
+namespace lbind
+{
+	namespace Bench
+	{
+		namespace
+		{
+			struct Registered
+			{
+				const char * name;
+				Benchmark benchmark;
+			};
+
+			std::vector<Registered>& registry()
+			{
+				static std::vector<Registered> benchmarks;
+				return benchmarks;
+			}
+
+			//Nearest rank, on sorted samples.
+			double percentile(const std::vector<double>& sorted, double p)
+			{
+				size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+				return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+			}
+
+			double median(const std::vector<double>& sorted)
+			{
+				size_t middle = sorted.size() / 2;
+				if (sorted.size() % 2)
+				{
+					return sorted[middle];
+				}
+
+				return (sorted[middle - 1] + sorted[middle]) / 2;
+			}
+
+			std::string quote(const std::string& s)
+			{
+				std::string out = "\"";
+				for (char c : s)
+				{
+					switch (c)
+					{
+					case '"': out += "\\\""; break;
+					case '\\': out += "\\\\"; break;
+					case '\n': out += "\\n"; break;
+					default: out += c;
+					}
+				}
+
+				return out + "\"";
+			}
+
+			void writeJson(const std::string& path, const std::vector<Result>& results, const std::vector<Measurement>& measurements)
+			{
+				std::ofstream out(path);
+				if (!out)
+				{
+					throw std::runtime_error("Could not write " + path);
+				}
+
+				out << "{\n\t\"benchmarks\": [\n";
+				for (size_t i = 0; i < results.size(); ++i)
+				{
+					const Result& r = results[i];
+					out << fmt::format("\t\t{{ \"group\": {}, \"name\": {}, \"operations\": {}, \"samples\": {}, "
+						"\"median_ns\": {:.3f}, \"p90_ns\": {:.3f}, \"p99_ns\": {:.3f}, \"min_ns\": {:.3f}, \"max_ns\": {:.3f}, \"ratio\": {:.3f}, \"allocations\": {:.3f} }}",
+						quote(r.group), quote(r.name), r.operations, r.samples, r.median, r.p90, r.p99, r.min, r.max, r.ratio, r.allocations);
+					out << (i + 1 < results.size() ? ",\n" : "\n");
+				}
+
+				out << "\t],\n\t\"measurements\": [\n";
+				for (size_t i = 0; i < measurements.size(); ++i)
+				{
+					const Measurement& m = measurements[i];
+					out << fmt::format("\t\t{{ \"group\": {}, \"name\": {}, \"value\": {:.3f}, \"unit\": {} }}",
+						quote(m.group), quote(m.name), m.value, quote(m.unit));
+					out << (i + 1 < measurements.size() ? ",\n" : "\n");
+				}
+
+				out << "\t]\n}\n";
+			}
+
+			/*
+				Reads back what writeJson writes. This is a plain JSON parser, but only the objects
+				with a group, name and median_ns are kept.
+			*/
+			class BaselineReader
+			{
+			public:
+				explicit BaselineReader(const std::string& text)
+					:text(text)
+					,position(0)
+				{}
+
+				std::map<std::string, double> read()
+				{
+					value();
+					return medians;
+				}
+			private:
+				void fail()
+				{
+					throw std::runtime_error(fmt::format("Malformed baseline at offset {}", position));
+				}
+
+				void skip()
+				{
+					while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position])))
+					{
+						position++;
+					}
+				}
+
+				bool consume(char c)
+				{
+					skip();
+					if (position < text.size() && text[position] == c)
+					{
+						position++;
+						return true;
+					}
+
+					return false;
+				}
+
+				std::string string()
+				{
+					if (!consume('"'))
+					{
+						fail();
+					}
+
+					std::string out;
+					while (position < text.size() && text[position] != '"')
+					{
+						if (text[position] == '\\' && position + 1 < text.size())
+						{
+							position++;
+							out += text[position] == 'n' ? '\n' : text[position];
+						}
+						else
+						{
+							out += text[position];
+						}
+
+						position++;
+					}
+
+					if (!consume('"'))
+					{
+						fail();
+					}
+
+					return out;
+				}
+
+				//Returns the value if it is a number or a string, so that objects can pick out fields.
+				std::string value()
+				{
+					skip();
+					if (position >= text.size())
+					{
+						fail();
+					}
+
+					char c = text[position];
+					if (c == '{')
+					{
+						object();
+						return std::string();
+					}
+
+					if (c == '[')
+					{
+						position++;
+						if (consume(']'))
+						{
+							return std::string();
+						}
+
+						do
+						{
+							value();
+						} while (consume(','));
+
+						if (!consume(']'))
+						{
+							fail();
+						}
+
+						return std::string();
+					}
+
+					if (c == '"')
+					{
+						return string();
+					}
+
+					size_t start = position;
+					while (position < text.size() && std::strchr("+-.0123456789eEtruefalsn", text[position]))
+					{
+						position++;
+					}
+
+					if (start == position)
+					{
+						fail();
+					}
+
+					return text.substr(start, position - start);
+				}
+
+				void object()
+				{
+					position++;
+
+					std::map<std::string, std::string> fields;
+					if (!consume('}'))
+					{
+						do
+						{
+							std::string key = string();
+							if (!consume(':'))
+							{
+								fail();
+							}
+
+							fields[key] = value();
+						} while (consume(','));
+
+						if (!consume('}'))
+						{
+							fail();
+						}
+					}
+
+					if (fields.count("group") && fields.count("name") && fields.count("median_ns"))
+					{
+						medians[fields["group"] + "/" + fields["name"]] = std::atof(fields["median_ns"].c_str());
+					}
+				}
+
+				const std::string& text;
+				size_t position;
+				std::map<std::string, double> medians;
+			};
+
+			std::map<std::string, double> readBaseline(const std::string& path)
+			{
+				std::ifstream in(path);
+				if (!in)
+				{
+					throw std::runtime_error("Could not read " + path);
+				}
+
+				std::stringstream text;
+				text << in.rdbuf();
+
+				std::string contents = text.str();
+				return BaselineReader(contents).read();
+			}
+
+			//Returns the number of regressions.
+			size_t compare(const std::vector<Result>& results, const std::map<std::string, double>& baseline, double threshold)
+			{
+				size_t regressions = 0;
+
+				std::cout << "\n" << fmt::format("{:48s} {:>12s} {:>12s} {:>8s}", "compared to baseline", "before", "after", "change") << "\n";
+				for (const Result& r : results)
+				{
+					auto found = baseline.find(r.group + "/" + r.name);
+					if (found == baseline.end() || found->second <= 0)
+					{
+						continue;
+					}
+
+					double change = r.median / found->second - 1;
+					bool regressed = change > threshold;
+					regressions += regressed;
+
+					std::cout << fmt::format("{:48s} {:12.1f} {:12.1f} {:+7.1f}%{}", r.group + "/" + r.name, found->second, r.median, change * 100, regressed ? "  REGRESSION" : "") << "\n";
+				}
+
+				return regressions;
+			}
+
+			Options parse(int argc, char * argv[])
+			{
+				Options options;
+				for (int i = 1; i < argc; ++i)
+				{
+					std::string arg = argv[i];
+					auto next = [&]() -> std::string
+					{
+						if (i + 1 >= argc)
+						{
+							throw std::runtime_error("Missing value for " + arg);
+						}
+
+						return argv[++i];
+					};
+
+					if (arg == "--filter") options.filter = next();
+					else if (arg == "--warmup") options.warmup = std::stoul(next());
+					else if (arg == "--samples") options.samples = std::max<size_t>(std::stoul(next()), 1);
+					else if (arg == "--threads") options.threads = std::stoul(next());
+					else if (arg == "--json") options.json = next();
+					else if (arg == "--baseline") options.baseline = next();
+					else if (arg == "--threshold") options.threshold = std::stod(next());
+					else if (arg == "--trace") options.trace = next();
+					else if (arg == "--list") options.list = true;
+					else
+					{
+						throw std::runtime_error("Unknown argument " + arg);
+					}
+				}
+
+				return options;
+			}
+		}
+
+		Group::Group(const char * name, const Options& options, std::vector<Result>& results, std::vector<Measurement>& measurements)
+			:name(name)
+			,options(options)
+			,results(results)
+			,measurements(measurements)
+			,first(results.size())
+		{}
+
+		bool Group::selected(const char * run) const
+		{
+			if (options.list)
+			{
+				std::cout << name << "/" << run << "\n";
+				return false;
+			}
+
+			return (name + "/" + run).find(options.filter) != std::string::npos;
+		}
+
+		void Group::rebase()
+		{
+			first = results.size();
+		}
+
+		void Group::measure(const char * run, double value, const char * unit)
+		{
+			if (!selected(run))
+			{
+				return;
+			}
+
+			measurements.push_back(Measurement{ name, run, value, unit });
+			std::cout << fmt::format("{:48s} {:12.1f} {}", name + "/" + run, value, unit) << std::endl;
+		}
+
+		size_t Group::threads() const
+		{
+			if (options.threads)
+			{
+				return options.threads;
+			}
+
+			return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		}
+
+		const std::string& Group::trace() const
+		{
+			return options.trace;
+		}
+
+		void Group::record(const char * run, size_t operations, std::vector<double>& samples, size_t allocations)
+		{
+			size_t timed = std::max<size_t>(operations * samples.size(), 1);
+
+			for (double& s : samples)
+			{
+				s /= static_cast<double>(std::max<size_t>(operations, 1));
+			}
+
+			std::sort(samples.begin(), samples.end());
+
+			Result r;
+			r.group = name;
+			r.name = run;
+			r.operations = operations;
+			r.samples = samples.size();
+			r.median = median(samples);
+			r.p90 = percentile(samples, 0.90);
+			r.p99 = percentile(samples, 0.99);
+			r.min = samples.front();
+			r.max = samples.back();
+			r.ratio = 1;
+			r.allocations = static_cast<double>(allocations) / static_cast<double>(timed);
+
+			if (first < results.size() && results[first].median > 0)
+			{
+				r.ratio = r.median / results[first].median;
+			}
+
+			results.push_back(r);
+
+			std::cout << fmt::format("{:48s} {:12.1f} {:12.1f} {:12.1f} {:8.2f}x", name + "/" + run, r.median, r.p90, r.p99, r.ratio);
+			if (countingAllocations())
+			{
+				std::cout << fmt::format(" {:10.2f}", r.allocations);
+			}
+
+			std::cout << std::endl;
+		}
+
+		void check(bool condition, const char * what)
+		{
+			if (!condition)
+			{
+				throw std::runtime_error(fmt::format("Check failed: {}", what));
+			}
+		}
+
+		BenchState::BenchState()
+			:state(luaL_newstate())
+		{
+			countLuaAllocations(state);
+			lbind::open(state);
+			luaL_openlibs(state);
+		}
+
+		BenchState::~BenchState()
+		{
+			lbind::close(state);
+			lua_close(state);
+		}
+
+		void BenchState::run(const std::string& script)
+		{
+			if (luaL_dostring(state, script.c_str()))
+			{
+				std::string error = lua_tostring(state, -1);
+				lua_pop(state, 1);
+				throw std::runtime_error(error);
+			}
+		}
+
+		Registration::Registration(const char * name, Benchmark benchmark)
+		{
+			registry().push_back(Registered{ name, benchmark });
+		}
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	using namespace lbind::Bench;
+
+	Options options;
+	try
+	{
+		options = parse(argc, argv);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		return 2;
+	}
+
+	std::vector<Result> results;
+	std::vector<Measurement> measurements;
+	size_t failures = 0;
+
+	if (!options.list)
+	{
+		std::cout << fmt::format("{:48s} {:>12s} {:>12s} {:>12s} {:>9s}", "ns per operation", "median", "p90", "p99", "ratio");
+		std::cout << (countingAllocations() ? fmt::format(" {:>10s}\n", "allocs/op") : "\n");
+	}
+
+	for (const Registered& b : registry())
+	{
+		Group group(b.name, options, results, measurements);
+		try
+		{
+			b.benchmark(group);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << b.name << " failed: " << e.what() << "\n";
+			failures++;
+		}
+	}
+
+	if (options.list)
+	{
+		return 0;
+	}
+
+	try
+	{
+		if (!options.json.empty())
+		{
+			writeJson(options.json, results, measurements);
+		}
+
+		if (!options.baseline.empty() && compare(results, readBaseline(options.baseline), options.threshold))
+		{
+			failures++;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << "\n";
+		return 2;
+	}
+
+	return failures ? 1 : 0;
+}
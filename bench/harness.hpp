@@ -0,0 +1,206 @@
+#pragma once
+#include <lua.hpp>
+#include "allocations.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace lbind
+{
+	namespace Bench
+	{
+		/*
+			A small benchmark harness, run through the luabinding_bench target.
+
+				LBIND_BENCHMARK(free_functions)
+				{
+					BenchState s;
+					...
+					group.run("raw", 100 * 1000, [&]() { ... });
+					group.run("bound", 100 * 1000, [&]() { ... });
+				}
+
+			Each run is warmed up, then timed over a number of samples of the given iterations. The
+			median, percentiles and spread are reported per operation, along with the ratio to the
+			first run in the group, which is the raw Lua C API version where there is one.
+
+				luabinding_bench [--filter text] [--warmup n] [--samples n] [--threads n] [--list]
+				                 [--json out.json] [--baseline old.json] [--threshold 0.10]
+				                 [--trace recorded.lbtrace]
+
+			Built with LBIND_COUNT_ALLOCATIONS, heap allocations per operation are reported too.
+
+			With --baseline, medians are compared against a previous --json output, and runs that
+			got slower by more than the threshold fail the run.
+		*/
+		struct Options
+		{
+			Options()
+				:warmup(1)
+				,samples(10)
+				,threads(0)
+				,threshold(0.10)
+				,list(false)
+			{}
+
+			size_t warmup;
+			size_t samples;
+
+			//The most threads scaling benchmarks use. 0 is the hardware concurrency.
+			size_t threads;
+
+			//Only runs whose "group/name" contains this are timed.
+			std::string filter;
+
+			std::string json;
+			std::string baseline;
+			double threshold;
+
+			//A trace from a Recorder, for the replay benchmark to replay instead of its own.
+			std::string trace;
+
+			bool list;
+		};
+
+		struct Result
+		{
+			std::string group;
+			std::string name;
+
+			//Per sample.
+			size_t operations;
+			size_t samples;
+
+			//In nanoseconds per operation.
+			double median;
+			double p90;
+			double p99;
+			double min;
+			double max;
+
+			//Median relative to the first run in the group.
+			double ratio;
+
+			//Heap allocations per operation, when built with LBIND_COUNT_ALLOCATIONS.
+			double allocations;
+		};
+
+		//A value a benchmark reports alongside its timings, like the memory a state holds.
+		struct Measurement
+		{
+			std::string group;
+			std::string name;
+			double value;
+			std::string unit;
+		};
+
+		class Group
+		{
+		public:
+			Group(const char * name, const Options& options, std::vector<Result>& results, std::vector<Measurement>& measurements);
+
+			template<typename F>
+			void run(const char * name, size_t iterations, F&& f)
+			{
+				run(name, iterations, 1, f);
+			}
+
+			//For runs where each call to f does several operations, like a script that loops over a
+			//bound function. Times are then reported per operation.
+			template<typename F>
+			void run(const char * name, size_t iterations, size_t operations, F&& f)
+			{
+				if (!selected(name))
+				{
+					return;
+				}
+
+				for (size_t i = 0; i < options.warmup; ++i)
+				{
+					for (size_t j = 0; j < iterations; ++j)
+					{
+						f();
+					}
+				}
+
+				std::vector<double> samples;
+				samples.reserve(options.samples);
+
+				AllocationCounter allocations;
+
+				for (size_t i = 0; i < options.samples; ++i)
+				{
+					auto start = std::chrono::steady_clock::now();
+					for (size_t j = 0; j < iterations; ++j)
+					{
+						f();
+					}
+
+					auto end = std::chrono::steady_clock::now();
+					samples.push_back(static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));
+				}
+
+				record(name, iterations * operations, samples, allocations.count());
+			}
+
+			//Makes the next run the one that later runs are compared to.
+			void rebase();
+
+			//Reports a value that is not a time. Filtered like runs, and written to the JSON output,
+			//but not compared against a baseline.
+			void measure(const char * name, double value, const char * unit);
+
+			size_t threads() const;
+			const std::string& trace() const;
+		private:
+			bool selected(const char * name) const;
+			void record(const char * name, size_t operations, std::vector<double>& samples, size_t allocations);
+
+			std::string name;
+			const Options& options;
+			std::vector<Result>& results;
+			std::vector<Measurement>& measurements;
+
+			size_t first;
+		};
+
+		//Throws if the condition fails, which fails the group. Used to make sure that what is
+		//being timed actually did its work.
+		void check(bool condition, const char * what);
+
+		//Keeps a value from being optimized away.
+		template<typename T>
+		void keep(const T& value)
+		{
+			asm volatile("" : : "r,m"(value) : "memory");
+		}
+
+		//A state opened with lbind and the standard libraries.
+		struct BenchState
+		{
+			BenchState();
+			~BenchState();
+
+			BenchState(const BenchState&) = delete;
+			BenchState& operator=(const BenchState&) = delete;
+
+			//Throws with the Lua error message on failure.
+			void run(const std::string& script);
+
+			lua_State * state;
+		};
+
+		typedef void (*Benchmark)(Group&);
+
+		struct Registration
+		{
+			Registration(const char * name, Benchmark benchmark);
+		};
+	}
+}
+
+#define LBIND_BENCHMARK(name) \
+	static void name(lbind::Bench::Group& group); \
+	static lbind::Bench::Registration name##_registration(#name, &name); \
+	static void name(lbind::Bench::Group& group)
@@ -0,0 +1,266 @@
+#include "harness.hpp"
+#include "lbind.hpp"
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace lbind;
+using namespace lbind::Bench;
+
+LBIND_BENCHMARK(table_iteration)
+{
+	BenchState s;
+	s.run("t = {}; for i = 1, 100 * 1000 do t['k' .. i] = i end");
+
+	Object t = globals(s.state)["t"];
+	const size_t entries = 100 * 1000;
+
+	group.run("lua_next", 10, entries, [&]() {
+		double sum = 0;
+
+		lua_getglobal(s.state, "t");
+		lua_pushnil(s.state);
+		while (lua_next(s.state, -2))
+		{
+			sum += lua_tonumber(s.state, -1);
+			lua_pop(s.state, 1);
+		}
+
+		lua_pop(s.state, 1);
+		check(sum == 5000050000.0, "lua_next visits every entry");
+	});
+
+	group.run("Object", 10, entries, [&]() {
+		double sum = 0;
+		for (auto entry : t)
+		{
+			sum += entry.value<double>();
+		}
+
+		check(sum == 5000050000.0, "Object visits every entry");
+	});
+
+	group.run("Object keys", 10, entries, [&]() {
+		size_t length = 0;
+		for (auto entry : t)
+		{
+			length += entry.key<std::string_view>().size();
+		}
+
+		check(length > 0, "keys are read");
+	});
+}
+
+LBIND_BENCHMARK(array_transfer)
+{
+	BenchState s;
+	const size_t count = 50 * 1000;
+
+	std::vector<double> positions(count, 1.0);
+	globals(s.state)["positions"] = newarray(s.state, positions);
+	Object t = globals(s.state)["positions"];
+
+	group.run("raw read", 10, count, [&]() {
+		lua_getglobal(s.state, "positions");
+		size_t length = lua_rawlen(s.state, -1);
+		for (size_t i = 0; i < length; ++i)
+		{
+			lua_rawgeti(s.state, -1, i + 1);
+			positions[i] = lua_tonumber(s.state, -1);
+			lua_pop(s.state, 1);
+		}
+
+		lua_pop(s.state, 1);
+	});
+
+	group.run("ArrayView read", 10, count, [&]() {
+		ArrayView<double> view(t);
+		check(view.copyTo(positions.data(), positions.size()) == count, "the whole array is copied");
+	});
+
+	group.run("obj[i] read", 10, count, [&]() {
+		for (size_t i = 0; i < count; ++i)
+		{
+			positions[i] = t[static_cast<int>(i + 1)];
+		}
+	});
+
+	group.run("ArrayView write", 10, count, [&]() {
+		ArrayView<double> view(t);
+		view.assign(positions);
+	});
+
+	group.run("newarray", 10, count, [&]() {
+		Object created = newarray(s.state, positions);
+	});
+
+	group.run("obj[i] write", 10, count, [&]() {
+		for (size_t i = 0; i < count; ++i)
+		{
+			t[static_cast<int>(i + 1)] = positions[i];
+		}
+	});
+}
+
+LBIND_BENCHMARK(chained_lookup)
+{
+	BenchState s;
+	s.run("cfg = { server = { limits = { rps = 250 } } }");
+
+	Object cfg = globals(s.state)["cfg"];
+
+	group.run("lua_getfield", 100 * 1000, [&]() {
+		lua_getglobal(s.state, "cfg");
+		lua_getfield(s.state, -1, "server");
+		lua_getfield(s.state, -1, "limits");
+		lua_getfield(s.state, -1, "rps");
+		lua_Integer rps = lua_tointeger(s.state, -1);
+		lua_pop(s.state, 4);
+
+		keep(rps);
+	});
+
+	group.run("path proxy", 100 * 1000, [&]() {
+		int rps = cfg["server"]["limits"]["rps"];
+		keep(rps);
+	});
+
+	group.run("Object per level", 100 * 1000, [&]() {
+		Object server = cfg["server"];
+		Object limits = server["limits"];
+		int rps = limits["rps"];
+		keep(rps);
+	});
+}
+
+LBIND_BENCHMARK(object_access)
+{
+	BenchState s;
+	s.run("entity = { position_of_the_entity = 4.5 }");
+
+	Object entity = globals(s.state)["entity"];
+	Key position(s.state, "position_of_the_entity");
+
+	group.run("lua_getfield", 100 * 1000, [&]() {
+		lua_getglobal(s.state, "entity");
+		lua_getfield(s.state, -1, "position_of_the_entity");
+		double x = lua_tonumber(s.state, -1);
+		lua_pop(s.state, 2);
+
+		keep(x);
+	});
+
+	group.run("string key", 100 * 1000, [&]() {
+		double x = entity["position_of_the_entity"];
+		keep(x);
+	});
+
+	group.run("interned key", 100 * 1000, [&]() {
+		double x = entity[position];
+		keep(x);
+	});
+
+	group.run("lua_setfield", 100 * 1000, [&]() {
+		lua_getglobal(s.state, "entity");
+		lua_pushnumber(s.state, 4.5);
+		lua_setfield(s.state, -2, "position_of_the_entity");
+		lua_pop(s.state, 1);
+	});
+
+	group.run("string key write", 100 * 1000, [&]() {
+		entity["position_of_the_entity"] = 4.5;
+	});
+
+	group.run("push string", 100 * 1000, [&]() {
+		lua_pushstring(s.state, "position_of_the_entity");
+		lua_pop(s.state, 1);
+	});
+
+	group.run("push key", 100 * 1000, [&]() {
+		Convert<Key>::to(s.state, position);
+		lua_pop(s.state, 1);
+	});
+}
+
+LBIND_BENCHMARK(lua_function_calls)
+{
+	BenchState s;
+	s.run("function add(a, b) return a + b end");
+
+	Object add = globals(s.state)["add"];
+	LuaFunction<int(int, int)> typed(add);
+
+	group.run("raw pcall", 100 * 1000, [&]() {
+		lua_getglobal(s.state, "add");
+		lua_pushinteger(s.state, 1);
+		lua_pushinteger(s.state, 2);
+		lua_pcall(s.state, 2, 1, 0);
+		lua_Integer result = lua_tointeger(s.state, -1);
+		lua_pop(s.state, 1);
+
+		keep(result);
+	});
+
+	group.run("LuaFunction", 100 * 1000, [&]() {
+		keep(typed(1, 2));
+	});
+
+	group.run("call<int>", 100 * 1000, [&]() {
+		keep(call<int>(add, 1, 2));
+	});
+}
+
+LBIND_BENCHMARK(batched_calls)
+{
+	BenchState s;
+	const size_t count = 10 * 1000;
+	s.run("function handle(a, b) return a + b end");
+
+	LuaFunction<int(int, int)> handle(globals(s.state)["handle"]);
+
+	std::vector<std::tuple<int, int>> events;
+	for (size_t i = 0; i < count; ++i)
+	{
+		events.emplace_back(static_cast<int>(i), 1);
+	}
+
+	std::vector<int> results;
+	results.reserve(count);
+
+	group.run("raw pcall loop", 10, count, [&]() {
+		results.clear();
+		for (auto& e : events)
+		{
+			lua_getglobal(s.state, "handle");
+			lua_pushinteger(s.state, std::get<0>(e));
+			lua_pushinteger(s.state, std::get<1>(e));
+			lua_pcall(s.state, 2, 1, 0);
+			results.push_back(static_cast<int>(lua_tointeger(s.state, -1)));
+			lua_pop(s.state, 1);
+		}
+	});
+
+	group.run("call<int> loop", 10, count, [&]() {
+		Object fn = handle.object();
+
+		results.clear();
+		for (auto& e : events)
+		{
+			results.push_back(call<int>(fn, std::get<0>(e), std::get<1>(e)));
+		}
+	});
+
+	group.run("LuaFunction loop", 10, count, [&]() {
+		results.clear();
+		for (auto& e : events)
+		{
+			results.push_back(handle(std::get<0>(e), std::get<1>(e)));
+		}
+	});
+
+	group.run("callBatch", 10, count, [&]() {
+		results.clear();
+		check(callBatch(handle, events, results).ok(), "every call succeeds");
+	});
+}
@@ -0,0 +1,93 @@
+#include "harness.hpp"
+#include "workloads.hpp"
+#include "lbind.hpp"
+
+#include <filesystem>
+#include <string>
+
+using namespace lbind;
+using namespace lbind::Bench;
+
+namespace
+{
+	//A mix of the bound calls the other benchmarks time one at a time.
+	const char * session =
+		"local a = Int(0) "
+		"local n = 0 "
+		"for i = 1, 2500 do "
+		"  a:add(1) "
+		"  add(a, i) "
+		"  n = add_i(n, 1) "
+		"  add_o('x', 'y') "
+		"end";
+
+	const size_t sessionCalls = 2500 * 4;
+
+	struct TemporaryTrace
+	{
+		TemporaryTrace()
+			:path((std::filesystem::temp_directory_path() / "lbind_bench.lbtrace").string())
+		{}
+
+		~TemporaryTrace()
+		{
+			std::filesystem::remove(path);
+		}
+
+		std::string path;
+	};
+}
+
+/*
+	Replays a binding trace against a freshly bound state. Without --trace, the session above is
+	recorded first, which also times what recording costs compared to running it unrecorded.
+
+	Objects of the bound Int class are replaced by one made in the replaying state.
+*/
+LBIND_BENCHMARK(trace_replay)
+{
+	TemporaryTrace recorded;
+	std::string path = group.trace();
+
+	if (path.empty())
+	{
+		path = recorded.path;
+
+		BenchState s;
+		registerBindings(s.state);
+
+		group.run("script", 1, sessionCalls, [&]() {
+			s.run(session);
+		});
+
+		{
+			Recorder recorder(s.state, path);
+			group.run("script recorded", 1, sessionCalls, [&]() {
+				recorder.start();
+				s.run(session);
+				recorder.stop();
+			});
+		}
+
+		//The trace that is replayed only holds one run of the session.
+		Recorder once(s.state, path);
+		once.start();
+		s.run(session);
+		once.stop();
+	}
+
+	BenchState s;
+	registerBindings(s.state);
+	s.run("stand_in = Int(0)");
+
+	Replayer replayer(path);
+	replayer.substitute("Int", [](lua_State * l) {
+		lua_getglobal(l, "stand_in");
+	});
+
+	group.run("replay", 1, replayer.calls(), [&]() {
+		ReplayResult result = replayer.replay(s.state);
+		check(result.calls > 0, "the trace replays");
+		keep(result.calls);
+	});
+}
@@ -0,0 +1,324 @@
+#include "harness.hpp"
+#include "lbind.hpp"
+#include "binddsl.hpp"
+
+#include <algorithm>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fmt/format.h>
+
+using namespace lbind;
+using namespace lbind::Bench;
+
+namespace
+{
+	//Every generated class is a distinct type, since each needs its own Metatables<T>.
+	const size_t maxClasses = 128;
+
+	template<size_t I>
+	struct Synthetic
+	{
+		explicit Synthetic(int value)
+			:value(value)
+		{}
+
+		int method(int n)
+		{
+			return value + n;
+		}
+
+		int value;
+	};
+
+	//Never called: every candidate but the last takes a string, so calls with two ints try each
+	//of them before they find add.
+	int mismatch(int a, const std::string& b)
+	{
+		return a + static_cast<int>(b.size());
+	}
+
+	int add(int a, int b)
+	{
+		return a + b;
+	}
+
+	//How big a generated module is.
+	struct Shape
+	{
+		size_t scopes;
+		size_t functions;
+		size_t classes;
+		size_t methods;
+		size_t properties;
+		size_t overloads;
+
+		size_t bindings() const
+		{
+			return scopes * functions + classes * (1 + methods + properties) + overloads;
+		}
+	};
+
+	//Metatables<T> keeps the class name pointer, so every name lives until exit.
+	const std::vector<std::string>& names(const char * prefix, size_t count)
+	{
+		static std::list<std::pair<std::string, std::vector<std::string>>> all;
+		for (auto& generated : all)
+		{
+			if (generated.first == prefix && generated.second.size() >= count)
+			{
+				return generated.second;
+			}
+		}
+
+		all.emplace_back(prefix, std::vector<std::string>());
+		for (size_t i = 0; i < count; ++i)
+		{
+			all.back().second.push_back(fmt::format("{}{}", prefix, i));
+		}
+
+		return all.back().second;
+	}
+
+	template<size_t I>
+	void bindClass(Scope& scope, const Shape& shape)
+	{
+		typedef Synthetic<I> Class;
+
+		const std::vector<std::string>& methods = names("m", shape.methods);
+		const std::vector<std::string>& properties = names("p", shape.properties);
+
+		Detail::ClassRegistrar<Class> c = scope.class_<Class>(names("C", maxClasses)[I].c_str());
+		c.template constructor<int>();
+
+		for (size_t i = 0; i < shape.methods; ++i)
+		{
+			c.def(methods[i], &Class::method);
+		}
+
+		for (size_t i = 0; i < shape.properties; ++i)
+		{
+			c.def_readwrite(properties[i], &Class::value);
+		}
+
+		c.endclass();
+	}
+
+	typedef void (*ClassBinder)(Scope&, const Shape&);
+
+	template<size_t... I>
+	const ClassBinder * classBinders(std::index_sequence<I...>)
+	{
+		static const ClassBinder binders[] = { &bindClass<I>... };
+		return binders;
+	}
+
+	/*
+		Globals s0..sN are scopes of free functions f0..fN. Class Ci lives in scope s(i % scopes),
+		with methods m0..mN and properties p0..pN. visit is an overload set of that many candidates,
+		where only the last takes two ints.
+	*/
+	void bind(lua_State * state, const Shape& shape)
+	{
+		const std::vector<std::string>& scopes = names("s", shape.scopes);
+		const std::vector<std::string>& functions = names("f", shape.functions);
+
+		Scope root = module(state);
+		std::vector<Scope> children;
+		children.reserve(shape.scopes);
+
+		for (size_t i = 0; i < shape.scopes; ++i)
+		{
+			children.push_back(root.scope(scopes[i]));
+			for (size_t j = 0; j < shape.functions; ++j)
+			{
+				children.back().def(functions[j], add);
+			}
+		}
+
+		const ClassBinder * classes = classBinders(std::make_index_sequence<maxClasses>());
+		for (size_t i = 0; i < shape.classes; ++i)
+		{
+			classes[i](children[i % shape.scopes], shape);
+		}
+
+		for (size_t i = 1; i < shape.overloads; ++i)
+		{
+			root.def("visit", mismatch);
+		}
+
+		root.def("visit", add);
+
+		for (Scope& child : children)
+		{
+			child.endscope();
+		}
+
+		root.end();
+	}
+
+	std::string label(const Shape& shape)
+	{
+		return fmt::format("{}x{} scopes, {} classes of {}+{}, {} overloads",
+			shape.scopes, shape.functions, shape.classes, shape.methods, shape.properties, shape.overloads);
+	}
+
+	size_t entries(lua_State * state, int table)
+	{
+		size_t count = 0;
+
+		lua_pushnil(state);
+		while (lua_next(state, table))
+		{
+			count++;
+			lua_pop(state, 1);
+		}
+
+		return count;
+	}
+
+	//The series each grow one count from the same base.
+	std::vector<std::pair<const char *, std::vector<Shape>>> series()
+	{
+		const Shape base = { 1, 8, 8, 8, 4, 1 };
+
+		std::vector<std::pair<const char *, std::vector<Shape>>> out;
+
+		out.emplace_back("classes", std::vector<Shape>());
+		for (size_t n : { 1, 8, 32, 128 })
+		{
+			Shape s = base;
+			s.classes = n;
+			out.back().second.push_back(s);
+		}
+
+		out.emplace_back("methods", std::vector<Shape>());
+		for (size_t n : { 8, 64, 512 })
+		{
+			Shape s = base;
+			s.methods = n;
+			out.back().second.push_back(s);
+		}
+
+		out.emplace_back("properties", std::vector<Shape>());
+		for (size_t n : { 4, 64, 512 })
+		{
+			Shape s = base;
+			s.properties = n;
+			out.back().second.push_back(s);
+		}
+
+		out.emplace_back("scopes", std::vector<Shape>());
+		for (size_t n : { 1, 16, 128 })
+		{
+			Shape s = base;
+			s.scopes = n;
+			s.functions = 64;
+			out.back().second.push_back(s);
+		}
+
+		out.emplace_back("overloads", std::vector<Shape>());
+		for (size_t n : { 1, 8, 32, 128 })
+		{
+			Shape s = base;
+			s.overloads = n;
+			out.back().second.push_back(s);
+		}
+
+		return out;
+	}
+
+	const size_t callsPerScript = 100000;
+
+	//The call that each series should slow down, if anything does: always the last one added.
+	std::string callScript(const char * series, const Shape& shape)
+	{
+		std::string last = fmt::format("{}", shape.classes - 1);
+		std::string object = fmt::format("local o = s{}.C{}(1) ", (shape.classes - 1) % shape.scopes, last);
+		std::string loop = fmt::format("for i = 1, {} do ", callsPerScript);
+
+		if (std::string(series) == "properties")
+		{
+			return object + "local x = 0 " + loop + fmt::format("x = o.p{} end", shape.properties - 1);
+		}
+
+		if (std::string(series) == "scopes")
+		{
+			return "local x = 0 " + loop + fmt::format("x = s{}.f{}(x, 1) end", shape.scopes - 1, shape.functions - 1);
+		}
+
+		if (std::string(series) == "overloads")
+		{
+			return "local x = 0 " + loop + "x = visit(x, 1) end";
+		}
+
+		return object + loop + fmt::format("o:m{}(i) end", shape.methods - 1);
+	}
+}
+
+/*
+	Generates modules of growing size, to find where registration and lookups stop scaling. For
+	each shape, in series that grow one count at a time:
+
+		register    time per binding to open a state and bind the module, ratio to the smallest
+		heap        Lua heap after a full collection, less an empty state's, in KB
+		metadata    arena bytes held for binding metadata, in KB
+		metatable   entries in the instance metatable of the last class
+		call        time per call of the binding the series grows, ratio to the smallest
+*/
+LBIND_BENCHMARK(binding_scale)
+{
+	size_t emptyHeap;
+	{
+		BenchState s;
+		lua_gc(s.state, LUA_GCCOLLECT);
+		emptyHeap = static_cast<size_t>(lua_gc(s.state, LUA_GCCOUNT)) * 1024 + static_cast<size_t>(lua_gc(s.state, LUA_GCCOUNTB));
+	}
+
+	for (auto& grown : series())
+	{
+		group.rebase();
+		for (const Shape& shape : grown.second)
+		{
+			std::string name = fmt::format("{}: register {}", grown.first, label(shape));
+			group.run(name.c_str(), 1, shape.bindings(), [&]() {
+				BenchState s;
+				bind(s.state, shape);
+			});
+		}
+
+		for (const Shape& shape : grown.second)
+		{
+			BenchState s;
+			bind(s.state, shape);
+			lua_gc(s.state, LUA_GCCOLLECT);
+
+			size_t heap = static_cast<size_t>(lua_gc(s.state, LUA_GCCOUNT)) * 1024 + static_cast<size_t>(lua_gc(s.state, LUA_GCCOUNTB));
+			std::string name = fmt::format("{}: heap {}", grown.first, label(shape));
+			group.measure(name.c_str(), static_cast<double>(heap - std::min(heap, emptyHeap)) / 1024, "KB");
+
+			name = fmt::format("{}: metadata {}", grown.first, label(shape));
+			group.measure(name.c_str(), static_cast<double>(Detail::getInternalState(s.state)->metadataBytes()) / 1024, "KB");
+
+			s.run(fmt::format("last = getmetatable(s{}.C{}(0))", (shape.classes - 1) % shape.scopes, shape.classes - 1));
+			lua_getglobal(s.state, "last");
+			name = fmt::format("{}: metatable {}", grown.first, label(shape));
+			group.measure(name.c_str(), static_cast<double>(entries(s.state, lua_gettop(s.state))), "entries");
+			lua_pop(s.state, 1);
+		}
+
+		group.rebase();
+		for (const Shape& shape : grown.second)
+		{
+			BenchState s;
+			bind(s.state, shape);
+
+			std::string script = callScript(grown.first, shape);
+			std::string name = fmt::format("{}: call {}", grown.first, label(shape));
+			group.run(name.c_str(), 1, callsPerScript, [&]() {
+				s.run(script);
+			});
+		}
+	}
+}
@@ -0,0 +1,85 @@
+#include "harness.hpp"
+#include "workloads.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+
+using namespace lbind::Bench;
+
+namespace
+{
+	//1, 2, 4 and so on, up to and including the most threads asked for.
+	std::vector<size_t> threadCounts(size_t most)
+	{
+		std::vector<size_t> counts;
+		for (size_t n = 1; n < most; n *= 2)
+		{
+			counts.push_back(n);
+		}
+
+		counts.push_back(most);
+		return counts;
+	}
+}
+
+/*
+	Runs the performance_difference scripts on 1..N threads at once, each thread with its own
+	bound state. Times are per call on each thread, so a run that scales perfectly keeps the
+	ratio to its single threaded run at 1.00x, and the ratio is the inverse of the scaling
+	efficiency. Anything shared between states that the calls touch shows up as a ratio that
+	grows with the thread count.
+
+	States are created and bound on this thread before any worker starts: registering a class
+	writes the Metatables<T> statics, which are shared by every state, so registration can not
+	run concurrently with anything else.
+*/
+LBIND_BENCHMARK(thread_scaling)
+{
+	size_t most = group.threads();
+
+	std::vector<std::unique_ptr<BenchState>> states;
+	for (size_t i = 0; i < most; ++i)
+	{
+		states.emplace_back(new BenchState());
+		registerBindings(states.back()->state);
+	}
+
+	for (const Workload& w : scriptWorkloads())
+	{
+		group.rebase();
+
+		for (size_t threads : threadCounts(most))
+		{
+			std::string name = fmt::format("{} x{}", w.name, threads);
+			group.run(name.c_str(), 1, scriptWorkloadCalls, [&]() {
+				std::atomic<size_t> failures(0);
+
+				std::vector<std::thread> workers;
+				for (size_t i = 0; i < threads; ++i)
+				{
+					workers.emplace_back([&, i]() {
+						try
+						{
+							states[i]->run(w.script);
+						}
+						catch (const std::exception&)
+						{
+							failures++;
+						}
+					});
+				}
+
+				for (std::thread& t : workers)
+				{
+					t.join();
+				}
+
+				check(failures == 0, "every thread runs its script");
+			});
+		}
+	}
+}
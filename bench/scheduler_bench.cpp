@@ -0,0 +1,85 @@
+#include "harness.hpp"
+#include "workloads.hpp"
+#include "lbind.hpp"
+
+#include <future>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+
+using namespace lbind;
+using namespace lbind::Bench;
+
+namespace
+{
+	//Jobs per run, each a short script that makes bound calls.
+	const size_t jobs = 10 * 1000;
+
+	const char * script =
+		"function job(n) "
+		"	local x = 0 "
+		"	for i = 1, n do x = add_i(x, 1) end "
+		"	return x "
+		"end";
+
+	void setup(lua_State * state)
+	{
+		registerBindings(state);
+		if (luaL_dostring(state, script) != LUA_OK)
+		{
+			check(false, "the job script loads");
+		}
+	}
+}
+
+/*
+	Submits jobs from this thread to a Scheduler with 1..N workers and waits for all of them. Times
+	are per job, so the ratio to the single worker run is the inverse of the speedup. A job makes
+	100 bound calls, which is roughly the work of a small request handler; the scheduler's own
+	overhead is what stops the ratio from falling in line with the worker count.
+
+	How many jobs each run had to steal is reported alongside.
+*/
+LBIND_BENCHMARK(scheduler_throughput)
+{
+	size_t most = group.threads();
+
+	std::vector<size_t> counts;
+	for (size_t n = 1; n < most; n *= 2)
+	{
+		counts.push_back(n);
+	}
+
+	counts.push_back(most);
+
+	std::vector<std::future<int>> results;
+	results.reserve(jobs);
+
+	for (size_t workers : counts)
+	{
+		SchedulerOptions options;
+		options.workers = workers;
+
+		Scheduler scheduler(setup, options);
+
+		std::string name = fmt::format("jobs x{}", workers);
+		group.run(name.c_str(), 1, jobs, [&]() {
+			for (size_t i = 0; i < jobs; ++i)
+			{
+				results.push_back(scheduler.submit<int>("job", 100));
+			}
+
+			bool correct = true;
+			for (std::future<int>& result : results)
+			{
+				correct = result.get() == 100 && correct;
+			}
+
+			results.clear();
+			check(correct, "every job returns its count");
+		});
+
+		std::string stolen = fmt::format("stolen x{}", workers);
+		group.measure(stolen.c_str(), static_cast<double>(scheduler.stolen()), "jobs");
+	}
+}
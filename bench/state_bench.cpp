@@ -0,0 +1,68 @@
+#include "harness.hpp"
+#include "lbind.hpp"
+#include "binddsl.hpp"
+
+#include <chrono>
+#include <string>
+#include <fmt/format.h>
+
+using namespace lbind;
+using namespace lbind::Bench;
+
+namespace
+{
+	int add_i(int a, int b)
+	{
+		return a + b;
+	}
+}
+
+LBIND_BENCHMARK(profiler_overhead)
+{
+	BenchState s;
+	module(s.state)
+		.def("add_i", add_i)
+	.end();
+
+	std::string script = "local a = 0; for i = 1, 1000 * 1000 do a = add_i(a, 1) + i % 3 end";
+	const size_t loop = 1000 * 1000;
+
+	group.run("no profiler", 1, loop, [&]() {
+		s.run(script);
+	});
+
+	for (int period : { 10000, 1000, 100 })
+	{
+		Profiler profiler(s.state, std::chrono::microseconds(period));
+		profiler.start();
+
+		std::string name = fmt::format("profiler({}us)", period);
+		group.run(name.c_str(), 1, loop, [&]() {
+			s.run(script);
+		});
+	}
+}
+
+LBIND_BENCHMARK(pooled_allocator)
+{
+	std::string script = "local t = {} for i = 1, 100000 do t[i] = { x = i, y = tostring(i) } end";
+
+	group.run("luaL_newstate", 2, [&]() {
+		BenchState s;
+		s.run(script);
+	});
+
+	group.run("newstate", 2, [&]() {
+		lua_State * state = newstate();
+		check(luaL_dostring(state, script.c_str()) == LUA_OK, "the script runs");
+		closestate(state);
+	});
+
+	StateOptions limited;
+	limited.memoryLimit = 256 * 1024 * 1024;
+	group.run("newstate(limit)", 2, [&]() {
+		lua_State * state = newstate(limited);
+		check(luaL_dostring(state, script.c_str()) == LUA_OK, "the script runs");
+		closestate(state);
+	});
+}
@@ -0,0 +1,200 @@
+#include "workloads.hpp"
+#include "lbind.hpp"
+#include "binddsl.hpp"
+
+#include <cstring>
+#include <new>
+#include <string>
+
+using namespace lbind;
+
+namespace
+{
+	template<typename T>
+	struct Storage
+	{
+		explicit Storage(T t)
+			:stored(t)
+		{}
+
+		void add(const T& another)
+		{
+			stored += another;
+		}
+
+		Storage& fluent_add(const T& another)
+		{
+			add(another);
+			return *this;
+		}
+
+		T stored;
+	};
+
+	template<typename T>
+	void external_add(Storage<T> * val, int n)
+	{
+		val->stored += n;
+	}
+
+	int add_i(int a, int b)
+	{
+		return a + b;
+	}
+
+	double add_f(double a, double b)
+	{
+		return a + b;
+	}
+
+	std::string add_s(const std::string& a, const std::string& b)
+	{
+		return a + b;
+	}
+
+	int add_lua(lua_State * s)
+	{
+		lua_Integer a = lua_tointeger(s, 1);
+		lua_Integer b = lua_tointeger(s, 2);
+
+		lua_pushinteger(s, a + b);
+		return 1;
+	}
+
+	//What an overload set does by hand: pick on argument types.
+	int add_overloaded_lua(lua_State * s)
+	{
+		if (lua_isinteger(s, 1) && lua_isinteger(s, 2))
+		{
+			lua_pushinteger(s, lua_tointeger(s, 1) + lua_tointeger(s, 2));
+		}
+		else if (lua_isnumber(s, 1) && lua_isnumber(s, 2))
+		{
+			lua_pushnumber(s, lua_tonumber(s, 1) + lua_tonumber(s, 2));
+		}
+		else
+		{
+			lua_pushvalue(s, 1);
+			lua_pushvalue(s, 2);
+			lua_concat(s, 2);
+		}
+
+		return 1;
+	}
+
+	//A hand written class: a userdata holding the value, with a metatable.
+	const char * rawName = "RawInt";
+
+	int raw_new(lua_State * s)
+	{
+		void * block = lua_newuserdatauv(s, sizeof(Storage<int>), 0);
+		new (block) Storage<int>(static_cast<int>(lua_tointeger(s, 1)));
+
+		luaL_setmetatable(s, rawName);
+		return 1;
+	}
+
+	int raw_gc(lua_State * s)
+	{
+		static_cast<Storage<int> *>(lua_touserdata(s, 1))->~Storage<int>();
+		return 0;
+	}
+
+	int raw_add(lua_State * s)
+	{
+		Storage<int> * self = static_cast<Storage<int> *>(luaL_checkudata(s, 1, rawName));
+		self->add(static_cast<int>(lua_tointeger(s, 2)));
+		return 0;
+	}
+
+	int raw_index(lua_State * s)
+	{
+		Storage<int> * self = static_cast<Storage<int> *>(lua_touserdata(s, 1));
+		const char * key = lua_tostring(s, 2);
+		if (key && std::strcmp(key, "value") == 0)
+		{
+			lua_pushinteger(s, self->stored);
+			return 1;
+		}
+
+		luaL_getmetatable(s, rawName);
+		lua_pushvalue(s, 2);
+		lua_rawget(s, -2);
+		return 1;
+	}
+
+	int raw_newindex(lua_State * s)
+	{
+		Storage<int> * self = static_cast<Storage<int> *>(lua_touserdata(s, 1));
+		const char * key = lua_tostring(s, 2);
+		if (key && std::strcmp(key, "value") == 0)
+		{
+			self->stored = static_cast<int>(lua_tointeger(s, 3));
+		}
+
+		return 0;
+	}
+
+	void registerRaw(lua_State * s)
+	{
+		luaL_newmetatable(s, rawName);
+
+		lua_pushcfunction(s, raw_gc);
+		lua_setfield(s, -2, "__gc");
+
+		lua_pushcfunction(s, raw_index);
+		lua_setfield(s, -2, "__index");
+
+		lua_pushcfunction(s, raw_newindex);
+		lua_setfield(s, -2, "__newindex");
+
+		lua_pushcfunction(s, raw_add);
+		lua_setfield(s, -2, "add");
+
+		lua_pop(s, 1);
+		lua_register(s, "RawInt", raw_new);
+	}
+}
+
+namespace lbind
+{
+	namespace Bench
+	{
+		void registerBindings(lua_State * s)
+		{
+			module(s)
+				.class_<Storage<int>>("Int")
+					.constructor<int>()
+					.def("add", &Storage<int>::fluent_add, returns_self)
+					.def("addnr", &Storage<int>::add)
+					.def_readwrite("value", &Storage<int>::stored)
+				.endclass()
+				.def("add", external_add<int>)
+				.def("add_i", add_i)
+				.def("add_o", add_i)
+				.def("add_o", add_f)
+				.def("add_o", add_s)
+			.end();
+
+			lua_register(s, "add_raw", add_lua);
+			lua_register(s, "add_overloaded_raw", add_overloaded_lua);
+			registerRaw(s);
+		}
+
+		const std::vector<Workload>& scriptWorkloads()
+		{
+			static const std::vector<Workload> workloads =
+			{
+				{ "raw(a, 1)", "a = 0; for i = 1, 1000 * 1000 do add_raw(a, 1) end" },
+				{ "a:add", "a = Int(0); for i = 1, 1000 * 1000 do a:add(1) end" },
+				{ "a:addnr", "a = Int(0); for i = 1, 1000 * 1000 do a:addnr(1) end" },
+				{ "a+=1", "a = 0; for i = 1, 1000 * 1000 do a = a + 1 end" },
+				{ "add(a, 1)", "a = Int(0); for i = 1, 1000 * 1000 do add(a, 1) end" },
+				{ "cadd(a, 1)", "a = 0; for i = 1, 1000 * 1000 do a = add_i(a, 1) end" },
+				{ "ladd(a, 1)", "function add_g(a, b) return a + b end a = 0; local add_n = add_g; for i = 1, 1000 * 1000 do a = add_n(a, 1) end" },
+			};
+
+			return workloads;
+		}
+	}
+}
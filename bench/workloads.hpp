@@ -0,0 +1,32 @@
+#pragma once
+#include <lua.hpp>
+
+#include <vector>
+
+namespace lbind
+{
+	namespace Bench
+	{
+		/*
+			Binds the functions and classes the binding benchmarks call from scripts:
+
+				Int                   a class with a constructor, add (returns_self), addnr and value
+				add, add_i            free functions taking an Int and two ints
+				add_o                 an overload set over ints, doubles and strings
+
+			and hand written Lua C API versions of the same things: add_raw, add_overloaded_raw and
+			the RawInt class.
+		*/
+		void registerBindings(lua_State * state);
+
+		struct Workload
+		{
+			const char * name;
+			const char * script;
+		};
+
+		//Scripts that each make a million calls of one kind, from the raw C function to a Lua one.
+		const std::vector<Workload>& scriptWorkloads();
+		const size_t scriptWorkloadCalls = 1000 * 1000;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace lbind
+{
+	namespace Detail
+	{
+		//Hands out memory from large blocks, and only gives it back all at once.
+		class Arena
+		{
+		public:
+			explicit Arena(size_t blockSize = 64 * 1024);
+			~Arena();
+
+			Arena(const Arena&) = delete;
+			Arena& operator=(const Arena&) = delete;
+
+			//Never returns null. Throws std::bad_alloc if a new block cannot be allocated.
+			void * allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+			//Frees every block. Everything handed out before is invalid afterwards.
+			void release();
+
+			//Bytes reserved from the system, including what has not been handed out yet.
+			size_t reserved() const;
+		private:
+			size_t blockSize;
+			std::vector<char *> blocks;
+
+			char * current;
+			size_t remaining;
+			size_t reservedBytes;
+		};
+	}
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include "lua.hpp"
+#include "object.h"
+#include "exceptions.hpp"
+
+#include <boost/static_assert.hpp>
+#include <vector>
+
+namespace lbind
+{
+	/*
+		A typed view over the array part of a table, for moving whole arrays of primitives
+		between Lua and contiguous C++ buffers.
+
+			ArrayView<double> positions(globals(state)["positions"]);
+
+			std::vector<double> current = positions.toVector();
+			positions.assign(updated.data(), updated.size());
+
+			globals(state)["velocities"] = newarray(state, velocities.data(), velocities.size());
+
+		Elements are read and written with lua_rawgeti/lua_rawseti, so metamethods are not
+		invoked, and the table is only pushed once per bulk operation.
+	*/
+	template<typename T>
+	class ArrayView
+	{
+		BOOST_STATIC_ASSERT(Convert<T>::is_primitive::value);
+	public:
+		explicit ArrayView(const Object& o)
+			:interpreter(o.state())
+			,table(o)
+			,canonical(0)
+		{}
+
+		explicit ArrayView(const StackObject& o)
+			:interpreter(o.state())
+			,canonical(o.index())
+		{}
+
+		//Otherwise the proxies' templated conversion operators would be picked to produce an ArrayView.
+		template<typename K, typename O>
+		explicit ArrayView(const Detail::ObjectProxy<K, O>& proxy)
+			:ArrayView(proxy.operator Object())
+		{}
+
+		template<typename O, typename... K>
+		explicit ArrayView(const Detail::PathProxy<O, K...>& proxy)
+			:ArrayView(proxy.operator Object())
+		{}
+
+		//The border of the array, as given by lua_rawlen.
+		size_t size() const
+		{
+			StackCheck check(interpreter, pushCount(), 0);
+			return static_cast<size_t>(lua_rawlen(interpreter, push()));
+		}
+
+		//Copies up to count elements into out, returning how many were copied.
+		//Throws BadCast if an element cannot be converted to T.
+		size_t copyTo(T * out, size_t count) const
+		{
+			StackCheck check(interpreter, pushCount(), 0);
+			int t = push();
+
+			size_t length = static_cast<size_t>(lua_rawlen(interpreter, t));
+			if (count > length)
+			{
+				count = length;
+			}
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				lua_rawgeti(interpreter, t, static_cast<lua_Integer>(i + 1));
+
+				typename Convert<T>::type value;
+				int res = Convert<T>::from(interpreter, -1, value);
+				lua_pop(interpreter, 1);
+
+				if (res < 0)
+				{
+					throw BadCast("Array element could not be converted to the view type");
+				}
+
+				out[i] = value;
+			}
+
+			return count;
+		}
+
+		std::vector<T> toVector() const
+		{
+			std::vector<T> result(size());
+			copyTo(result.data(), result.size());
+
+			return result;
+		}
+
+		//Replaces the contents of the array with count elements from data. Elements past
+		//the end of the new contents are cleared.
+		void assign(const T * data, size_t count)
+		{
+			StackCheck check(interpreter, pushCount(), 0);
+			int t = push();
+
+			size_t length = static_cast<size_t>(lua_rawlen(interpreter, t));
+			for (size_t i = 0; i < count; ++i)
+			{
+				Convert<T>::to(interpreter, data[i]);
+				lua_rawseti(interpreter, t, static_cast<lua_Integer>(i + 1));
+			}
+
+			//Clear from the back, so that the border moves down with each removal.
+			for (size_t i = length; i > count; --i)
+			{
+				lua_pushnil(interpreter);
+				lua_rawseti(interpreter, t, static_cast<lua_Integer>(i));
+			}
+		}
+
+		void assign(const std::vector<T>& data)
+		{
+			assign(data.data(), data.size());
+		}
+	private:
+		int pushCount() const
+		{
+			return canonical ? 0 : 1;
+		}
+
+		//Returns the absolute index of the table, pushing it if it is held in the registry.
+		int push() const
+		{
+			if (canonical)
+			{
+				return canonical;
+			}
+
+			lua_rawgeti(interpreter, LUA_REGISTRYINDEX, table.index());
+			return lua_gettop(interpreter);
+		}
+
+		lua_State * interpreter;
+		Object table;
+		int canonical;
+	};
+
+	//Creates a new array presized to hold count elements, and fills it from data.
+	template<typename T>
+	Object newarray(lua_State * state, const T * data, size_t count)
+	{
+		BOOST_STATIC_ASSERT(Convert<T>::is_primitive::value);
+		StackCheck check(state, 1, 0);
+
+		lua_createtable(state, static_cast<int>(count), 0);
+		for (size_t i = 0; i < count; ++i)
+		{
+			Convert<T>::to(state, data[i]);
+			lua_rawseti(state, -2, static_cast<lua_Integer>(i + 1));
+		}
+
+		return Object::fromStack(state, -1);
+	}
+
+	template<typename T>
+	Object newarray(lua_State * state, const std::vector<T>& data)
+	{
+		return newarray(state, data.data(), data.size());
+	}
+}
@@ -0,0 +1,358 @@
+#pragma once
+#include <lua.hpp>
+#include <boost/optional.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "convert.hpp"
+#include "coroutinepool.hpp"
+#include "internal.hpp"
+#include "object.h"
+
+namespace lbind
+{
+	class EventLoop;
+
+	namespace Detail
+	{
+		//What an Async shares between the bound function that made it and whoever completes it.
+		class AsyncBase
+		{
+		public:
+			AsyncBase();
+			virtual ~AsyncBase();
+
+			AsyncBase(const AsyncBase&) = delete;
+			AsyncBase& operator=(const AsyncBase&) = delete;
+
+			bool ready() const;
+			void fail(const std::string& message);
+
+			//The values push leaves on the stack, 0 or 1.
+			virtual int results() const = 0;
+			virtual void push(lua_State * state) const = 0;
+		protected:
+			//Marks this done, and has the loop resume the coroutine waiting on it, if any.
+			void finish(std::unique_lock<std::mutex>& held);
+
+			mutable std::mutex lock;
+			bool done;
+		private:
+			friend class lbind::EventLoop;
+			friend int awaitAsync(lua_State *, std::shared_ptr<AsyncBase>);
+
+			bool failed;
+			std::string error;
+
+			//Set while a coroutine is suspended on this.
+			EventLoop * loop;
+			lua_State * thread;
+		};
+
+		template<typename T>
+		class AsyncState : public AsyncBase
+		{
+		public:
+			void set(T v)
+			{
+				std::unique_lock<std::mutex> held(lock);
+				if (!done)
+				{
+					value = std::move(v);
+					finish(held);
+				}
+			}
+
+			int results() const
+			{
+				return 1;
+			}
+
+			void push(lua_State * state) const
+			{
+				Convert<typename Undecorate<T>::type>::to(state, *value);
+			}
+		private:
+			boost::optional<T> value;
+		};
+
+		template<>
+		class AsyncState<void> : public AsyncBase
+		{
+		public:
+			void set()
+			{
+				std::unique_lock<std::mutex> held(lock);
+				if (!done)
+				{
+					finish(held);
+				}
+			}
+
+			int results() const
+			{
+				return 0;
+			}
+
+			void push(lua_State *) const
+			{}
+		};
+
+		//Told what becomes of a coroutine started for it, instead of the loop deciding.
+		class CoroutineObserver
+		{
+		public:
+			//The coroutine yielded results values, on top of its stack, with coroutine.yield. The
+			//loop pops them after. Returns false to have the loop resume it next turn, as it
+			//does for coroutines without an observer. If this throws, the coroutine is closed and
+			//forgotten before the exception leaves the loop.
+			virtual bool yielded(lua_State * thread, int results) = 0;
+
+			//The coroutine returned results values, on top of its stack, or raised error if that
+			//is not null. The thread is released right after.
+			virtual void finished(lua_State * thread, int results, const std::string * error) = 0;
+		protected:
+			~CoroutineObserver()
+			{}
+		};
+
+		class LuaCoroutine;
+
+		//Hands a pending Async to FunctionBase::apply, which suspends the calling coroutine on it.
+		//Returns the values pushed when it has already completed, so that no yield is needed.
+		int awaitAsync(lua_State * state, std::shared_ptr<AsyncBase> pending);
+	}
+
+	/*
+		A value a bound function produces later. Returning one from a bound function suspends the
+		calling coroutine until it is resolved, and resumes it with the value as the result of the
+		call, or raises the error it was rejected with.
+
+			Async<std::string> fetch(int id)
+			{
+				Async<std::string> result;
+				requests.send(id, [result](std::string body) { result.resolve(body); });
+				return result;
+			}
+
+		Either can be called from any thread, once. Only coroutines started by EventLoop::spawn can
+		suspend, and the loop they belong to resumes them. An Async resolved before it is returned
+		does not suspend at all.
+	*/
+	template<typename T>
+	class Async
+	{
+	public:
+		Async()
+			:state(std::make_shared<Detail::AsyncState<T>>())
+		{}
+
+		void resolve(T value) const
+		{
+			state->set(std::move(value));
+		}
+
+		void reject(const std::string& message) const
+		{
+			state->fail(message);
+		}
+
+		bool ready() const
+		{
+			return state->ready();
+		}
+
+		const std::shared_ptr<Detail::AsyncState<T>>& shared() const
+		{
+			return state;
+		}
+	private:
+		std::shared_ptr<Detail::AsyncState<T>> state;
+	};
+
+	template<>
+	class Async<void>
+	{
+	public:
+		Async()
+			:state(std::make_shared<Detail::AsyncState<void>>())
+		{}
+
+		void resolve() const
+		{
+			state->set();
+		}
+
+		void reject(const std::string& message) const
+		{
+			state->fail(message);
+		}
+
+		bool ready() const
+		{
+			return state->ready();
+		}
+
+		const std::shared_ptr<Detail::AsyncState<void>>& shared() const
+		{
+			return state;
+		}
+	private:
+		std::shared_ptr<Detail::AsyncState<void>> state;
+	};
+
+	//Only converts to Lua, as the result of a bound function. Converting a pending one anywhere
+	//else throws BadCast.
+	template<typename T>
+	struct Convert<Async<T>, void>
+	{
+		typedef Async<T> type;
+		typedef boost::false_type is_primitive;
+
+		static type&& forward(type&& t)
+		{
+			return std::move(t);
+		}
+
+		template<typename U>
+		static U&& universal(type&& t)
+		{
+			return static_cast<U&&>(t);
+		}
+
+		static int from(lua_State *, int, type&)
+		{
+			return -1;
+		}
+
+		static int to(lua_State * state, const type& in)
+		{
+			return Detail::awaitAsync(state, in.shared());
+		}
+	};
+
+	/*
+		Runs coroutines that wait on Async results, on one thread, along with timers and work
+		posted from other threads.
+
+			EventLoop loop(state);
+			loop.spawn(globals(state)["handler"], request);
+			loop.run();
+
+		Timers live in a hashed wheel of slots one tick wide, so adding and firing one is constant
+		time. They fire on the first tick at or after their deadline, in no particular order within
+		a tick.
+
+		Coroutines come from a CoroutinePool owned by the loop, so spawning one reuses a finished
+		coroutine where it can.
+
+		Coroutines that yield with coroutine.yield are resumed on the next turn of the loop. An
+		error in a coroutine ends it, and is thrown from spawn, run or poll as a LuaError. Exceptions
+		from posted work and timers are thrown from run and poll too, and the loop can be run again
+		afterwards.
+
+		Everything but post must be called on the thread running the loop. Only one loop can run a
+		state at a time, and it must outlive the Asyncs its coroutines wait on, or they are
+		abandoned.
+	*/
+	class EventLoop
+	{
+	public:
+		explicit EventLoop(lua_State * state, std::chrono::microseconds tick = std::chrono::milliseconds(1));
+		~EventLoop();
+
+		EventLoop(const EventLoop&) = delete;
+		EventLoop& operator=(const EventLoop&) = delete;
+
+		//Calls the function in a new coroutine, until it finishes or first suspends.
+		template<typename... Args>
+		void spawn(const Object& function, Args&&... args)
+		{
+			lua_State * thread = create(function);
+			(void)std::initializer_list<int>{0, (Convert<typename Undecorate<Args>::type>::to(thread, args), 0)...};
+
+			resume(thread, sizeof...(Args));
+		}
+
+		//Runs f on the loop thread. Can be called from any thread.
+		void post(std::function<void()> f);
+
+		//Runs f on the loop thread once delay has passed.
+		void after(std::chrono::microseconds delay, std::function<void()> f);
+
+		//Runs until there are no coroutines, timers or posted work left.
+		void run();
+
+		//Runs posted work and due timers without waiting. Returns how many ran.
+		size_t poll();
+
+		//Coroutines that have not finished.
+		size_t coroutines() const;
+	private:
+		friend class Detail::AsyncBase;
+		friend class Detail::LuaCoroutine;
+		friend int Detail::suspend(lua_State *, Detail::InternalState *);
+
+		struct Coroutine
+		{
+			PooledCoroutine thread;
+			std::shared_ptr<Detail::AsyncBase> waiting;
+			Detail::CoroutineObserver * observer;
+		};
+
+		struct Timer
+		{
+			boost::uint64_t deadline;
+			std::function<void()> f;
+		};
+
+		lua_State * create(const Object& function, Detail::CoroutineObserver * observer = nullptr);
+		void resume(lua_State * thread, int arguments);
+
+		//Stops telling a coroutine's observer about it, which leaves it to the loop. Both do
+		//nothing unless the thread is still the observer's, since a thread the loop forgot can be
+		//handed out again.
+		void detach(lua_State * thread, Detail::CoroutineObserver * observer);
+
+		//Gives a coroutine that is not running back to the pool, closing it, and forgets it.
+		void release(lua_State * thread, Detail::CoroutineObserver * observer);
+
+		//Resumes a thread with the result of the Async it waits on.
+		void complete(lua_State * thread);
+
+		//Suspends a thread on an Async. Returns false if the thread is not one of this loop's.
+		bool wait(lua_State * thread, std::shared_ptr<Detail::AsyncBase> pending);
+
+		boost::uint64_t elapsedTicks() const;
+		size_t fireTimers();
+
+		lua_State * state;
+
+		//Outlives threads, which hand their coroutines back to it.
+		CoroutinePool pool;
+		std::unordered_map<lua_State *, Coroutine> threads;
+
+		std::chrono::microseconds tick;
+		std::chrono::steady_clock::time_point start;
+		boost::uint64_t currentTick;
+		std::vector<std::vector<Timer>> wheel;
+		size_t timers;
+
+		//Shared with other threads.
+		mutable std::mutex lock;
+		std::condition_variable wake;
+		std::vector<std::function<void()>> posted;
+
+		//Posted work being run, kept to reuse its storage.
+		std::vector<std::function<void()>> running;
+	};
+}
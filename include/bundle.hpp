@@ -0,0 +1,103 @@
+#pragma once
+#include "lua.hpp"
+#include "object.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <string>
+#include <vector>
+
+namespace lbind
+{
+	namespace Detail
+	{
+		struct BundleHeader
+		{
+			char magic[4];
+			boost::uint32_t version;
+			boost::uint64_t count;
+		};
+
+		//Entries are sorted by name. Offsets are from the start of the file.
+		struct BundleEntry
+		{
+			boost::uint64_t nameOffset;
+			boost::uint64_t nameLength;
+			boost::uint64_t offset;
+			boost::uint64_t size;
+		};
+	}
+
+	/*
+		A read only file of precompiled chunks, mapped into memory.
+
+			Bundle scripts("scripts.lbb");
+			scripts.install(state);
+
+			lua: local patrol = require("ai.patrol")
+
+		Chunks are handed to lua_load straight from the mapping, so every state and process
+		loading the same bundle shares the same pages. install adds a package.searchers entry
+		that resolves require against the bundle index without touching the filesystem.
+
+		The bundle must outlive every state it is installed into.
+	*/
+	class Bundle
+	{
+	public:
+		//Throws BindingError if the file cannot be mapped or is not a bundle for this Lua version.
+		explicit Bundle(const std::string& path);
+		~Bundle();
+
+		Bundle(const Bundle&) = delete;
+		Bundle& operator=(const Bundle&) = delete;
+
+		size_t size() const;
+		bool contains(boost::string_ref name) const;
+		std::vector<std::string> names() const;
+
+		//Loads the chunk for name without running it. Throws LuaError if it is missing or invalid.
+		Object load(lua_State * state, boost::string_ref name) const;
+
+		//Adds a searcher after package.preload, so preloaded modules still win.
+		void install(lua_State * state) const;
+	private:
+		const Detail::BundleEntry * find(boost::string_ref name) const;
+		boost::string_ref nameOf(const Detail::BundleEntry& entry) const;
+		int loadEntry(lua_State * state, const Detail::BundleEntry& entry) const;
+
+		static int searcher(lua_State * state);
+
+		const char * data;
+		size_t length;
+		const Detail::BundleEntry * entries;
+		size_t count;
+	};
+
+	//Builds bundle files. Sources are compiled with a scratch state.
+	class BundleWriter
+	{
+	public:
+		BundleWriter();
+
+		//Throws LuaError if the source does not compile.
+		void add(boost::string_ref name, boost::string_ref source);
+		void addBytecode(boost::string_ref name, std::string bytecode);
+
+		//Strips debug information from chunks added after this is set.
+		void strip(bool s);
+
+		//Throws BindingError if the file cannot be written.
+		void write(const std::string& path) const;
+	private:
+		struct Chunk
+		{
+			std::string name;
+			std::string bytecode;
+		};
+
+		std::vector<Chunk> chunks;
+		bool stripDebug;
+	};
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "lua.hpp"
+#include "object.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace lbind
+{
+	namespace Detail
+	{
+		//FNV-1a over the chunk name and source.
+		boost::uint64_t hashChunk(boost::string_ref source, boost::string_ref name);
+
+		//Appends the lua_dump bytecode of the function at index to out.
+		void dumpFunction(lua_State * state, int index, std::string& out, bool strip = false);
+	}
+
+	/*
+		Caches compiled chunks so the same script is only parsed once per process.
+
+			ChunkCache cache("/var/cache/game/luac");
+			Object chunk = cache.load(state, source, "=ai/patrol.lua");
+			call<void>(chunk);
+
+		Chunks are keyed by a hash of their source and name, and are looked up in three places:
+			- The function already loaded into this state, which is returned as is.
+			- Bytecode compiled by any state in this process, which only needs lua_load.
+			- Bytecode persisted in the cache directory, if one was given.
+
+		Files in the directory are checked against the Lua version and the source hash before use,
+		so stale or foreign files are recompiled rather than loaded. A cache can be shared between
+		threads, but each lua_State must still only be used by one thread at a time.
+	*/
+	class ChunkCache
+	{
+	public:
+		struct Counters
+		{
+			size_t stateHits;
+			size_t memoryHits;
+			size_t diskHits;
+			size_t compiles;
+		};
+
+		ChunkCache();
+		explicit ChunkCache(const std::string& directory);
+
+		ChunkCache(const ChunkCache&) = delete;
+		ChunkCache& operator=(const ChunkCache&) = delete;
+
+		//Returns the compiled chunk, compiling it if needed. Throws LuaError on a syntax error.
+		Object load(lua_State * state, boost::string_ref source, boost::string_ref name = "=chunk");
+
+		//Forgets the bytecode kept in memory. Functions already loaded into states are kept.
+		void clear();
+
+		Counters counters() const;
+		const std::string& directory() const;
+	private:
+		bool loadBytecode(lua_State * state, boost::uint64_t hash, size_t sourceSize, boost::string_ref name);
+		bool readFile(boost::uint64_t hash, size_t sourceSize, std::string& out) const;
+		void writeFile(boost::uint64_t hash, size_t sourceSize, const std::string& bytecode) const;
+		std::string path(boost::uint64_t hash) const;
+
+		std::string cacheDirectory;
+
+		//Only held to find or change entries. Bytecode is shared, so it can be loaded without it.
+		mutable std::mutex lock;
+		std::unordered_map<boost::uint64_t, std::shared_ptr<const std::string>> bytecode;
+
+		std::atomic<size_t> stateHits;
+		std::atomic<size_t> memoryHits;
+		std::atomic<size_t> diskHits;
+		std::atomic<size_t> compiles;
+	};
+}
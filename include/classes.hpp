@@ -5,6 +5,8 @@
 #include "function.hpp"
 #include "policies.hpp"
 
+#include <boost/type_traits/remove_cv.hpp>
+
 namespace lbind
 {
 	class Scope;
@@ -28,6 +30,9 @@ namespace lbind
 			static const char * name;
 			static int instanceMetatableIndex;
 			static int staticMetatableIndex;
+
+			//Reports the memory an instance holds outside of its userdata. Null means sizeof(T).
+			static size_t (*size)(const T&);
 		};
 
 		template<typename T>
@@ -39,6 +44,46 @@ namespace lbind
 		template<typename T>
 		int Metatables<T>::staticMetatableIndex = 0;
 
+		template<typename T>
+		size_t (*Metatables<T>::size)(const T&) = nullptr;
+
+		template<typename T>
+		size_t externalSize(const T * object)
+		{
+			return Metatables<T>::size ? Metatables<T>::size(*object) : sizeof(T);
+		}
+
+		//Whether the value at index is a userdata with the instance metatable of T, and so
+		//holds a pointer to a T.
+		template<typename T>
+		bool isInstance(lua_State * state, int index)
+		{
+			if (lua_type(state, index) != LUA_TUSERDATA || !lua_getmetatable(state, index))
+			{
+				return false;
+			}
+
+			lua_rawgeti(state, LUA_REGISTRYINDEX, Metatables<typename boost::remove_cv<T>::type>::instanceMetatableIndex);
+			bool same = lua_rawequal(state, -1, -2) != 0;
+			lua_pop(state, 2);
+
+			return same;
+		}
+
+		//Lua only sees the pointer sized userdata of a bound object, so the memory behind objects
+		//that lua owns is reported to the collector separately.
+		template<typename T>
+		void trackOwned(lua_State * state, T * in)
+		{
+			typedef typename boost::remove_cv<T>::type Class;
+
+			void * pointer = const_cast<Class *>(in);
+			if (ownership(pointer) == Owned)
+			{
+				getInternalState(state)->addExternalMemory(state, externalSize(static_cast<const Class *>(ownershipless(pointer))));
+			}
+		}
+
 		//Basically a runtime version of Metatables
 		struct ClassRepresentation
 		{
@@ -211,6 +256,13 @@ namespace lbind
 				if (ownership(userdata) == Owned)
 				{
 					T * val = static_cast<T *>(ownershipless(userdata));
+
+					//Unset when the state is closed after lbind::close.
+					if (InternalState * internal = getInternalState(s))
+					{
+						internal->removeExternalMemory(externalSize<T>(val));
+					}
+
 					delete val;
 				}
 
@@ -322,7 +374,7 @@ namespace lbind
 			ClassRegistrar& constructor()
 			{
 				boost::fusion::vector<null_policy_t> np;
-				constructors.push_back(Detail::createFunction(Construct0<T>::invoke, np));
+				constructors.push_back(Detail::createFunction(state, Construct0<T>::invoke, np));
 				return *this;
 			}
 
@@ -330,7 +382,15 @@ namespace lbind
 			ClassRegistrar& constructor()
 			{
 				boost::fusion::vector<null_policy_t> np;
-				constructors.push_back(Detail::createFunction(Construct<T, AT...>::invoke, np));
+				constructors.push_back(Detail::createFunction(state, Construct<T, AT...>::invoke, np));
+				return *this;
+			}
+
+			//Sets how much memory an instance holds, for instances whose size is not just sizeof(T),
+			//like ones that own buffers. This should not change over the lifetime of an instance.
+			ClassRegistrar& size(size_t (*callback)(const T&))
+			{
+				Metatables<T>::size = callback;
 				return *this;
 			}
 
@@ -359,7 +419,7 @@ namespace lbind
 				BOOST_STATIC_ASSERT(boost::is_member_object_pointer<M>::value);
 				assert(metatable.index() == lua_gettop(state));
 
-				MemberBase * member = new ReadonlyMember<T, M>(m);
+				MemberBase * member = getInternalState(state)->create<ReadonlyMember<T, M>>(m);
 				lua_pushlightuserdata(state, member);
 				lua_setfield(state, -2, name.data());
 
@@ -374,7 +434,7 @@ namespace lbind
 				BOOST_STATIC_ASSERT(boost::is_member_object_pointer<M>::value);
 				assert(metatable.index() == lua_gettop(state));
 
-				MemberBase * member = new ReadWriteMember<T, M>(m);
+				MemberBase * member = getInternalState(state)->create<ReadWriteMember<T, M>>(m);
 				lua_pushlightuserdata(state, member);
 				lua_setfield(state, -2, name.data());
 
@@ -385,7 +445,7 @@ namespace lbind
 			template<typename G>
 			ClassRegistrar& property(boost::string_ref name, G getter)
 			{
-				MemberBase * member = new PropertyReadOnlyMember<T, G>(getter);
+				MemberBase * member = getInternalState(state)->create<PropertyReadOnlyMember<T, G>>(getter);
 				lua_pushlightuserdata(state, member);
 				lua_setfield(state, -2, name.data());
 
@@ -395,7 +455,7 @@ namespace lbind
 			template<typename G, typename S>
 			ClassRegistrar& property(boost::string_ref name, G getter, S setter)
 			{
-				MemberBase * member = new PropertyMember<T, G, S>(getter, setter);
+				MemberBase * member = getInternalState(state)->create<PropertyMember<T, G, S>>(getter, setter);
 				lua_pushlightuserdata(state, member);
 				lua_setfield(state, -2, name.data());
 
@@ -404,7 +464,9 @@ namespace lbind
 
 			Scope& endclass()
 			{
-				StackCheck check(state, 1, 0);
+				//Pops the class table registerClass left, so registering many classes does not
+				//grow the stack.
+				StackCheck check(state, 2, -1);
 
 				using namespace lbind::Detail;
 				assert(metatable.index() == lua_gettop(state));
@@ -424,6 +486,10 @@ namespace lbind
 				lua_pushcclosure(state, &ClassRegistrar<T>::collect, 1);
 				lua_setfield(state, -2, "__gc");
 
+				//Names instances in error messages and traces, as luaL_newmetatable does.
+				lua_pushstring(state, representation->name);
+				lua_setfield(state, -2, "__name");
+
 				//Also we need a metatable for __call for constructors.
 				if (constructors.size())
 				{
@@ -432,15 +498,18 @@ namespace lbind
 					FunctionBase * ctor = constructors[0];
 					if (constructors.size() > 1)
 					{
-						OverloadedFunction * f = new OverloadedFunction();
+						OverloadedFunction * f = internal->create<OverloadedFunction>();
 						f->canidates = constructors;
 						ctor = f;
 
+						nameFunction(state, f, representation->name);
+
 						internal->registerFunction(f);
 					}
 
 					for (size_t i = 0; i < constructors.size(); ++i)
 					{
+						nameFunction(state, constructors[i], representation->name);
 						internal->registerFunction(constructors[i]);
 					}
 
@@ -499,6 +568,11 @@ namespace lbind
 		// NB: type is a T*
 		static int from(lua_State * state, int index, type& out)
 		{
+			if (!Detail::isInstance<typename boost::remove_pointer<Undecorated>::type>(state, index))
+			{
+				return -1;
+			}
+
 			type* block = static_cast<type*>(lua_touserdata(state, index));
 			out = static_cast<type>(Detail::ownershipless(*block));
 			return 1;
@@ -517,6 +591,8 @@ namespace lbind
 			//Set metatable and return.
 			lua_setmetatable(state, -2);
 
+			Detail::trackOwned(state, in);
+
 			//Do we have a metatable?
 			return 1;
 		}
@@ -528,7 +604,9 @@ namespace lbind
 		boost::mpl::or_<
 			boost::is_pointer<T>,
 			boost::is_integral<T>,
-			boost::is_floating_point<T>
+			boost::is_floating_point<T>,
+			Detail::IsLuaFunction<T>,
+			Detail::IsAsync<T>
 		>>::type>
 	{
 		typedef typename Undecorate<T>::type Undecorated;
@@ -553,6 +631,11 @@ namespace lbind
 		//Converts a value at the given index. Must write to out, and return the number of stack objects consumed.
 		static int from(lua_State * state, int index, type& out)
 		{
+			if (!Detail::isInstance<Undecorated>(state, index))
+			{
+				return -1;
+			}
+
 			type * block = static_cast<type *>(lua_touserdata(state, index));
 			out = static_cast<type>(Detail::ownershipless(*block));
 			return 1;
@@ -579,6 +662,8 @@ namespace lbind
 			//Set metatable and return.
 			lua_setmetatable(state, -2);
 
+			Detail::trackOwned(state, in);
+
 			//Do we have a metatable?
 			return 1;
 		}
@@ -593,11 +678,15 @@ namespace lbind
 		//Create a new table.
 		lua_newtable(s);
 
-		Detail::ClassRepresentation * rep = new Detail::ClassRepresentation();
+		Detail::InternalState * internal = Detail::getInternalState(s);
+
+		Detail::ClassRepresentation * rep = internal->create<Detail::ClassRepresentation>();
 		rep->instanceIndex = &Detail::Metatables<T>::instanceMetatableIndex;
 		rep->staticIndex = &Detail::Metatables<T>::staticMetatableIndex;
-		rep->name = name;
+		rep->name = internal->copyString(name);
 
+		//Shared by every state, so this keeps the caller's pointer rather than one into an arena that
+		//goes away with this state.
 		Detail::Metatables<T>::name = name;
 		return Detail::ClassRegistrar<T>(s, lbind::StackObject::fromStack(s, -1), rep, scopeIndex, scope);
 	}
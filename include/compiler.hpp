@@ -0,0 +1,43 @@
+#pragma once
+#include "lua.hpp"
+#include "object.h"
+
+#include <string>
+#include <vector>
+
+namespace lbind
+{
+	struct Script
+	{
+		std::string name;
+		std::string source;
+	};
+
+	//Either the loaded chunk or the error it failed with.
+	struct CompileResult
+	{
+		bool ok() const
+		{
+			return error.empty();
+		}
+
+		Object function;
+		std::string error;
+	};
+
+	/*
+		Compiles a set of scripts on a pool of threads, and loads them into state.
+
+			std::vector<CompileResult> loaded = compileParallel(state, scripts);
+			for (auto& r : loaded)
+			{
+				if (r.ok()) call<void>(r.function);
+			}
+
+		Each worker parses in its own scratch state and dumps the bytecode. Once all of them are done,
+		the bytecode is loaded into state on the calling thread, so state is never touched concurrently.
+		Results are in the same order as scripts. A threads value of 0 uses one per hardware thread.
+		Failures on a worker, such as running out of memory, are reported as the script's error.
+	*/
+	std::vector<CompileResult> compileParallel(lua_State * state, const std::vector<Script>& scripts, size_t threads = 0);
+}
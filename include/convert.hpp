@@ -7,6 +7,7 @@
 #include <boost/utility/string_ref.hpp>
 #include <boost/mpl/or.hpp>
 #include <cassert>
+#include <string_view>
 
 #include <iostream>
 #include "exceptions.hpp"
@@ -19,6 +20,33 @@ namespace lbind
 		typedef typename boost::remove_cv<typename boost::remove_reference<T>::type>::type type;
 	};
 
+	template<typename Signature>
+	class LuaFunction;
+
+	template<typename T>
+	class Async;
+
+	namespace Detail
+	{
+		//LuaFunction has its own converter, so the default converter for classes must not match it.
+		template<typename T>
+		struct IsLuaFunction : boost::false_type
+		{};
+
+		template<typename Signature>
+		struct IsLuaFunction<LuaFunction<Signature>> : boost::true_type
+		{};
+
+		//As is Async.
+		template<typename T>
+		struct IsAsync : boost::false_type
+		{};
+
+		template<typename T>
+		struct IsAsync<Async<T>> : boost::true_type
+		{};
+	}
+
 	struct Ignored
 	{
 		Ignored()
@@ -217,6 +245,50 @@ namespace lbind
 		}
 	};
 
+	//Views into a string on the stack. The view is only valid while the string stays on the stack,
+	//but unlike std::string conversion it never allocates.
+	template<>
+	struct Convert<std::string_view, void>
+	{
+		typedef std::string_view type;
+		typedef boost::true_type is_primitive;
+
+		static std::string_view&& forward(type&& t)
+		{
+			return std::move(t);
+		}
+
+		template<typename T>
+		static T&& universal(type&& t)
+		{
+			return std::move(t);
+		}
+
+		static int from(lua_State * state, int index, type& out)
+		{
+			if (lua_type(state, index) != LUA_TSTRING)
+			{
+				return -1;
+			}
+
+			size_t length = 0;
+			const char * res = lua_tolstring(state, index, &length);
+			if (!res)
+			{
+				return -1;
+			}
+
+			out = std::string_view(res, length);
+			return 1;
+		}
+
+		static int to(lua_State * state, std::string_view in)
+		{
+			lua_pushlstring(state, in.data(), in.size());
+			return 1;
+		}
+	};
+
 	template<typename T>
 	struct Convert<T, typename boost::enable_if<boost::is_integral<T>>::type>
 	{
@@ -0,0 +1,141 @@
+#pragma once
+#include <lua.hpp>
+
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "convert.hpp"
+#include "object.h"
+
+namespace lbind
+{
+	class CoroutinePool;
+
+	struct CoroutinePoolOptions
+	{
+		CoroutinePoolOptions()
+			:stackDepth(LUA_MINSTACK * 8)
+			,capacity(64)
+			,prewarm(0)
+		{}
+
+		//Free stack slots each coroutine has when it is handed out, so calls that stay within
+		//them do not reallocate its stack.
+		int stackDepth;
+
+		//Idle coroutines kept for reuse. Ones released beyond this are left to the collector.
+		size_t capacity;
+
+		//Coroutines created when the pool is.
+		size_t prewarm;
+	};
+
+	/*
+		A Lua coroutine borrowed from a CoroutinePool, and given back when the handle is destroyed
+		or released, however the coroutine ended.
+
+			PooledCoroutine co = pool.acquire();
+			if (co.start(globals(state)["handle"], request) == LUA_OK)
+			{
+				std::string response = indexCast<std::string>(co.get(), -1);
+			}
+
+		Results are left on the coroutine's stack until the next resume, or until it is released.
+	*/
+	class PooledCoroutine
+	{
+	public:
+		PooledCoroutine();
+		PooledCoroutine(PooledCoroutine&& other);
+		PooledCoroutine& operator=(PooledCoroutine&& other);
+		~PooledCoroutine();
+
+		PooledCoroutine(const PooledCoroutine&) = delete;
+		PooledCoroutine& operator=(const PooledCoroutine&) = delete;
+
+		//Resumes the coroutine with the function and its arguments. Returns what lua_resume does.
+		template<typename... Args>
+		int start(const Object& function, Args&&... args)
+		{
+			Convert<Object>::to(thread, function);
+			(void)std::initializer_list<int>{0, (Convert<typename Undecorate<Args>::type>::to(thread, args), 0)...};
+
+			return resume(sizeof...(Args));
+		}
+
+		//Resumes a coroutine that yielded, with arguments values on top of its stack.
+		int resume(int arguments);
+
+		//Values left on the stack by the last resume.
+		int results() const;
+
+		lua_State * get() const;
+
+		//Gives the coroutine back to its pool early. The handle is empty afterwards.
+		void release();
+	private:
+		friend class CoroutinePool;
+		PooledCoroutine(CoroutinePool * pool, lua_State * thread, int ref);
+
+		CoroutinePool * pool;
+		lua_State * thread;
+		int ref;
+		int count;
+	};
+
+	/*
+		Keeps finished Lua coroutines of a state for reuse, so running a script per request does
+		not create a thread, and a stack and call chain for it, every time.
+
+			CoroutinePool pool(state);
+			PooledCoroutine co = pool.acquire();
+			co.start(globals(state)["handle"], request);
+
+		Coroutines are reset as they come back: ones that returned only have their stack cleared,
+		and ones that yielded or raised an error are closed with lua_closethread, which also runs
+		their pending to-be-closed variables. Closing shrinks the stack, so those are grown back to
+		stackDepth the next time they are handed out, as are stacks the collector shrank while idle.
+		Once enough coroutines are idle, acquiring and releasing them allocates nothing.
+
+		Coroutines share the globals of the state, so anything a script leaves there is seen by the
+		next one. The pool must outlive the coroutines it hands out, and can not be shared between
+		threads.
+	*/
+	class CoroutinePool
+	{
+	public:
+		explicit CoroutinePool(lua_State * state, const CoroutinePoolOptions& options = CoroutinePoolOptions());
+		~CoroutinePool();
+
+		CoroutinePool(const CoroutinePool&) = delete;
+		CoroutinePool& operator=(const CoroutinePool&) = delete;
+
+		//Throws LuaError if the stack can not be grown to stackDepth.
+		PooledCoroutine acquire();
+
+		size_t idle() const;
+
+		//Coroutines this pool has created, including ones it let go.
+		size_t created() const;
+
+		lua_State * state() const;
+	private:
+		friend class PooledCoroutine;
+
+		struct Idle
+		{
+			lua_State * thread;
+			int ref;
+		};
+
+		void create();
+		void release(lua_State * thread, int ref);
+
+		lua_State * owner;
+		CoroutinePoolOptions options;
+
+		std::vector<Idle> coroutines;
+		size_t made;
+	};
+}
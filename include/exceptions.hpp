@@ -14,4 +14,11 @@ namespace lbind
 	public:
 		explicit BindingError(const char * what);
 	};
+
+	//An error raised by Lua code called from C++.
+	class LuaError : public std::runtime_error
+	{
+	public:
+		explicit LuaError(const char * what);
+	};
 }
\ No newline at end of file
@@ -16,6 +16,7 @@
 #include <boost/fusion/include/at_c.hpp>
 #include <boost/fusion/include/pop_front.hpp>
 
+#include <functional>
 #include <vector>
 
 #include "object.h"
@@ -58,8 +59,11 @@ namespace lbind
 				{
 					//Failure to convert.
 					failed = true;
+					return;
 				}
 
+				LBIND_STATISTIC(Detail::countConversions(state, index, res));
+
 				index += res;
 			}
 
@@ -69,6 +73,34 @@ namespace lbind
 		};
 
 		struct OverloadedFunction;
+		struct FunctionBase;
+
+		//Marks a bound function as running for the profiler, recorder and statistics, and undoes
+		//the mark however the call ends. Exceptions unwind through the destructor, but lua_error
+		//and lua_yieldk may not, so finish has to be called before either.
+		class ActiveCall
+		{
+		public:
+			ActiveCall(lua_State * state, InternalState * internal, FunctionBase * function);
+			~ActiveCall();
+
+			ActiveCall(const ActiveCall&) = delete;
+			ActiveCall& operator=(const ActiveCall&) = delete;
+
+			void finish(int result);
+		private:
+			lua_State * state;
+			InternalState * internal;
+			FunctionBase * function;
+			FunctionBase * previous;
+			size_t recorded;
+			bool finished;
+
+#ifdef LBIND_STATISTICS
+			boost::uint64_t start;
+#endif
+		};
+
 		struct FunctionBase
 		{
 			virtual ~FunctionBase()
@@ -85,32 +117,110 @@ namespace lbind
 				int ind = lua_upvalueindex(1);
 				FunctionBase * b = static_cast<FunctionBase *>(lua_touserdata(l, ind));
 
-				int result = b->call(l);
-				if (result < 0)
+				InternalState * internal = getInternalState(l);
+
+				int result;
 				{
-					int s = lua_gettop(l);
+					ActiveCall active(l, internal, b);
+					result = b->call(l);
+					active.finish(result);
+				}
 
-					std::string msg = "No valid overload found for arguments of type: (";
-					for (int i = 1; i <= s; ++i)
+				if (result < 0)
+				{
+					//lua_error does not unwind, so the message must be destroyed before raising it.
 					{
-						if (i - 1)
+						int s = lua_gettop(l);
+
+						std::string msg = "No valid overload found for arguments of type: (";
+						for (int i = 1; i <= s; ++i)
 						{
-							msg += ", ";
+							if (i - 1)
+							{
+								msg += ", ";
+							}
+
+							msg += lua_typename(l, lua_type(l, i));
 						}
 
-						msg += lua_typename(l, lua_type(l, i));
+						msg += ")";
+						lua_pushstring(l, msg.c_str());
 					}
 
-					msg += ")";
-
-					lua_pushstring(l, msg.c_str());
 					lua_error(l);
 				}
 
+				//The call returned an Async that has not completed yet.
+				if (internal->suspending)
+				{
+					return suspend(l, internal);
+				}
+
 				return result;
 			}
+
+			FunctionBase()
+				:name("")
+			{}
+
+			//The name this was registered under, in the state's arena.
+			const char * name;
+
+#ifdef LBIND_STATISTICS
+			void record(lua_State * state, int results, boost::uint64_t elapsed);
+
+			FunctionStatistics statistics;
+#endif
 		};
 
+		inline ActiveCall::ActiveCall(lua_State * state, InternalState * internal, FunctionBase * function)
+			:state(state)
+			,internal(internal)
+			,function(function)
+			,previous(internal->activeFunction.load(std::memory_order_relaxed))
+			,recorded(0)
+			,finished(false)
+		{
+			//Mark the call, so a profiler can attribute time spent in C++ to this function.
+			internal->activeFunction.store(function, std::memory_order_relaxed);
+			internal->bindingDepth++;
+			recorded = internal->recorder ? internal->recorder->enterBinding(state, function, lua_gettop(state)) : 0;
+
+			LBIND_STATISTIC(start = Detail::now());
+		}
+
+		inline ActiveCall::~ActiveCall()
+		{
+			//Left by an exception, so there are no results.
+			finish(0);
+		}
+
+		inline void ActiveCall::finish(int result)
+		{
+			if (finished)
+			{
+				return;
+			}
+
+			finished = true;
+			internal->bindingDepth--;
+			LBIND_STATISTIC(function->record(state, result, Detail::now() - start));
+
+			internal->activeFunction.store(previous, std::memory_order_relaxed);
+
+			//The call may have stopped the recorder.
+			if (recorded && internal->recorder)
+			{
+				internal->recorder->leave(recorded, result);
+			}
+		}
+
+		//Names the function in statistics and profiles.
+		inline void nameFunction(lua_State * state, FunctionBase * f, boost::string_ref name)
+		{
+			f->name = getInternalState(state)->copyString(name);
+		}
+
 		template<typename F, bool isVoid, typename Policies>
 		struct Function
 		{};
@@ -129,9 +239,9 @@ namespace lbind
 
 				typename FunctionTraits<F>::lua_tuple args;
 
-				//Pull arguments from lua
+				//Pull arguments from lua. for_each copies its functor, so pass a reference to keep the failure flag.
 				PullFromLua pull(state);
-				for_each(args, pull);
+				for_each(args, std::ref(pull));
 
 				if (pull.failed)
 				{
@@ -180,7 +290,7 @@ namespace lbind
 
 				//Pull arguments from lua
 				PullFromLua pull(state);
-				for_each(args, pull);
+				for_each(args, std::ref(pull));
 
 				if (pull.failed)
 				{
@@ -224,7 +334,7 @@ namespace lbind
 
 				//Pull arguments from lua
 				PullFromLua pull(state);
-				for_each(args, pull);
+				for_each(args, std::ref(pull));
 
 				if (pull.failed)
 				{
@@ -266,7 +376,7 @@ namespace lbind
 
 				//Pull arguments from lua
 				PullFromLua pull(state);
-				for_each(args, pull);
+				for_each(args, std::ref(pull));
 
 				if (pull.failed)
 				{
@@ -300,6 +410,8 @@ namespace lbind
 					{
 						return res;
 					}
+
+					LBIND_STATISTIC(canidates[i]->statistics.overloadMisses++);
 				}
 
 				//No valid overloads found!
@@ -309,35 +421,36 @@ namespace lbind
 			std::vector<FunctionBase *> canidates;
 		};
 
+		//Functions are allocated in the state's arena, and destroyed when it is closed.
 		template<typename F, typename Op, typename P>
-		FunctionBase * createFunctionObject(F f, Op op, P p)
+		FunctionBase * createFunctionObject(lua_State * state, F f, Op op, P p)
 		{
-			return new FunctionObject<F, Op, boost::is_same<
+			return getInternalState(state)->create<FunctionObject<F, Op, boost::is_same<
 					void,
 					typename boost::function_types::result_type<Op>::type
 				>::value,
 				P
-			>(f);
+			>>(f);
 		}
 
 		//Function object overload
 		template<typename F, typename P>
-		FunctionBase * createFunction(F f, P p, typename boost::function_types::result_type<decltype(&F::operator())>::type * = nullptr)
+		FunctionBase * createFunction(lua_State * state, F f, P p, typename boost::function_types::result_type<decltype(&F::operator())>::type * = nullptr)
 		{
-			return createFunctionObject(f, &F::operator(), p);
+			return createFunctionObject(state, f, &F::operator(), p);
 		}
 
 		//Function overload
 		template<typename F, typename P>
-		FunctionBase * createFunction(F f, P p, typename boost::remove_reference<typename boost::function_types::result_type<F>::type>::type * = nullptr)
+		FunctionBase * createFunction(lua_State * state, F f, P p, typename boost::remove_reference<typename boost::function_types::result_type<F>::type>::type * = nullptr)
 		{
-			return new Function<F,
+			return getInternalState(state)->create<Function<F,
 				boost::is_same<
 					void,
 					typename boost::function_types::result_type<F>::type
 				>::value,
 				P
-			>(f);
+			>>(f);
 		}
 	}
 
@@ -345,7 +458,8 @@ namespace lbind
 	Detail::FunctionBase * pushFunction(lua_State * state, const char * name, F f, P p)
 	{
 		using namespace Detail;
-		Detail::FunctionBase * base = createFunction(f, p);
+		Detail::FunctionBase * base = createFunction(state, f, p);
+		Detail::nameFunction(state, base, name);
 
 		//Does this function already exist?
 			//If so, is the function overloaded already?
@@ -396,8 +510,9 @@ namespace lbind
 
 				if (!overloaded)
 				{
-					overloaded = new Detail::OverloadedFunction();
+					overloaded = internal->create<Detail::OverloadedFunction>();
 					overloaded->canidates.push_back(base);
+					Detail::nameFunction(state, overloaded, name);
 
 					internal->registerFunction(overloaded);
 
@@ -408,7 +523,8 @@ namespace lbind
 					//Stack is [function, old_upvalue]
 				}
 
-				Detail::FunctionBase * newFunction = Detail::createFunction(f, p);
+				Detail::FunctionBase * newFunction = Detail::createFunction(state, f, p);
+				Detail::nameFunction(state, newFunction, name);
 				internal->registerFunction(newFunction);
 
 				overloaded->canidates.push_back(newFunction);
@@ -0,0 +1,129 @@
+#pragma once
+#include <lua.hpp>
+#include <boost/cstdint.hpp>
+
+#include <chrono>
+
+namespace lbind
+{
+	struct GcOptions
+	{
+		enum Mode
+		{
+			Incremental,
+			Generational,
+
+			//Picks between the two from the allocation rate measured between steps.
+			Adaptive
+		};
+
+		GcOptions()
+			:mode(Adaptive)
+			,generationalRate(32 * 1024 * 1024)
+			,incrementalRate(8 * 1024 * 1024)
+			,window(std::chrono::milliseconds(500))
+		{}
+
+		Mode mode;
+
+		//In bytes per second. Adaptive controllers switch to generational mode once allocation
+		//reaches generationalRate, and back once it drops to incrementalRate.
+		double generationalRate;
+		double incrementalRate;
+
+		//How long allocation is measured for before the mode is reconsidered.
+		std::chrono::microseconds window;
+	};
+
+	struct GcStep
+	{
+		GcStep()
+			:elapsed(0)
+			,longestPause(0)
+			,collected(0)
+			,steps(0)
+			,cycles(0)
+		{}
+
+		//Time spent collecting, and the longest single step of it.
+		std::chrono::microseconds elapsed;
+		std::chrono::microseconds longestPause;
+
+		//Bytes freed from the lua heap.
+		size_t collected;
+
+		size_t steps;
+
+		//Incremental cycles finished. Generational collections do not count.
+		size_t cycles;
+	};
+
+	/*
+		Takes the collector of a state out of the allocator's hands, so it only runs when the host
+		asks it to.
+
+			GcController gc(state);
+			while (running)
+			{
+				frame();
+				gc.stepFor(timeLeftInFrame);
+			}
+
+		stepFor runs collector steps until the budget is spent or an incremental cycle finishes. A
+		single step can run past the budget, so budgets should leave room for one; its length is
+		reported as longestPause. In generational mode one step is a whole young collection, so
+		stepFor only runs one.
+
+		Nothing is collected between calls, so the host has to keep calling stepFor for memory to
+		be freed. Memory held by bound objects is not charged to the collector while a controller
+		is attached either.
+
+		Adaptive controllers measure how fast the state allocates and use generational mode for
+		states churning through short lived objects. Switching to generational mode runs a full
+		collection, so the thresholds are kept apart to avoid flip-flopping.
+
+		The previous mode is restored, and automatic collection restarted if it was running, when
+		the controller is destroyed. Only one controller can be attached to a state at a time.
+	*/
+	class GcController
+	{
+	public:
+		//Throws BindingError if another controller is attached to the state.
+		explicit GcController(lua_State * state, const GcOptions& options = GcOptions());
+		~GcController();
+
+		GcController(const GcController&) = delete;
+		GcController& operator=(const GcController&) = delete;
+
+		GcStep stepFor(std::chrono::microseconds budget);
+
+		bool generational() const;
+
+		//In bytes per second, over the last full window.
+		double allocationRate() const;
+
+		//Totals over every call to stepFor.
+		const GcStep& totals() const;
+	private:
+		size_t heapBytes() const;
+		void measure();
+		void setGenerational(bool on);
+
+		lua_State * state;
+		GcOptions options;
+
+		bool wasRunning;
+		bool wasGenerational;
+		bool isGenerational;
+
+		//Allocation since the window started, from how much the heap and external memory grew
+		//between steps.
+		std::chrono::steady_clock::time_point windowStart;
+		boost::uint64_t allocated;
+		size_t heapAfterStep;
+		size_t externalAfterStep;
+		double rate;
+
+		GcStep total;
+	};
+}
@@ -1,35 +1,132 @@
 #pragma once
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
 #include <vector>
 #include <lua.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/type_traits/has_trivial_destructor.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include "arena.hpp"
+#include "statistics.hpp"
 
 namespace lbind
 {
+	class Profiler;
+	class GcController;
+	class Recorder;
+	class EventLoop;
+
 	namespace Detail
 	{
 		struct FunctionBase;
+		class AsyncBase;
 
 		class InternalState
 		{
 		public:
+			InternalState();
 			~InternalState();
 
+			//Binding metadata lives in an arena until the state is closed, when destructors run
+			//in reverse order of creation and the arena is freed in one go.
+			template<typename T, typename... Args>
+			T * create(Args&&... args)
+			{
+				T * result = new (arena.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+				if (!boost::has_trivial_destructor<T>::value)
+				{
+					destructors.push_back(Destructor{ &InternalState::destroy<T>, result });
+				}
+
+				return result;
+			}
+
+			const char * copyString(boost::string_ref s);
 			void * allocate(size_t bytes);
+
+			//Bytes the arena has reserved for binding metadata.
+			size_t metadataBytes() const;
+
+			//Registered functions are listed for statistics and traces. They are owned by the arena.
 			void registerFunction(FunctionBase *);
+			const std::vector<FunctionBase *>& functions() const;
+
+			//Reference counting for registry slots shared between copies of an Object.
+			//release returns true once the last holder is gone and the slot should be unref'd.
+			void retain(int ref);
+			bool release(int ref);
+
+			//Memory held by C++ objects that lua owns. Each addition is also charged to the collector
+			//as debt, so collection keeps pace with the real cost of the garbage.
+			void addExternalMemory(lua_State * state, size_t bytes);
+			void removeExternalMemory(size_t bytes);
+			size_t externalMemory() const;
+
+			//Set while a Profiler is running on this state.
+			Profiler * profiler;
+
+			//Set while a Recorder is recording calls on this state.
+			Recorder * recorder;
+
+			//Set while a GcController paces the collector, which stops external memory from
+			//stepping it.
+			GcController * gcController;
+
+			//The bound function currently running, if any. Read by the profiler's timer thread.
+			std::atomic<FunctionBase *> activeFunction;
+
+			//Set while an EventLoop runs coroutines on this state.
+			EventLoop * eventLoop;
+
+			//An Async a bound function returned before it completed. Set by its converter, and
+			//taken by FunctionBase::apply once the call returns, to suspend the caller on it.
+			std::shared_ptr<AsyncBase> suspending;
+
+			//Bound functions running on this state, counted by FunctionBase::apply. A pending Async
+			//converted with none running is not a result, so it has nothing to suspend.
+			int bindingDepth;
+
+#ifdef LBIND_STATISTICS
+			Statistics statistics;
+
+			//Fills in the per function entries from the registered functions.
+			void collectFunctions(Statistics& out) const;
+			void resetFunctions();
+#endif
 		private:
-			std::vector<void *> allocations;
+			struct Destructor
+			{
+				void (*destroy)(void *);
+				void * object;
+			};
+
+			template<typename T>
+			static void destroy(void * object)
+			{
+				static_cast<T *>(object)->~T();
+			}
+
+			Arena arena;
+			std::vector<Destructor> destructors;
 			std::vector<FunctionBase *> registeredFunctions;
+
+			size_t externalBytes;
+
+			//Charged to the collector in whole kilobytes once enough has built up.
+			size_t externalDebt;
+
+			//Indexed by registry reference. luaL_unref recycles freed slots, so this only
+			//grows to the peak number of live references.
+			std::vector<boost::uint32_t> referenceCounts;
 		};
 
 		InternalState * getInternalState(lua_State *);
-	}
 
-	struct Statistics
-	{
-		size_t converts;
-		size_t luaToC;
-		size_t cToLua;
-	};
-
-	//Passing in null gets global statistics
-	const Statistics& getStatistics(lua_State *);
-}
\ No newline at end of file
+		//Yields the running coroutine until the Async in suspending completes. Raises an error if
+		//it can not yield. Defined with EventLoop.
+		int suspend(lua_State * state, InternalState * internal);
+	}
+}
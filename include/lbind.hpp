@@ -5,4 +5,18 @@
 #include "function.hpp"
 #include "classes.hpp"
 #include "table_iter.hpp"
-#include "init.hpp"
\ No newline at end of file
+#include "arrayview.hpp"
+#include "luafunction.hpp"
+#include "chunkcache.hpp"
+#include "bundle.hpp"
+#include "compiler.hpp"
+#include "profiler.hpp"
+#include "init.hpp"
+#include "state.hpp"
+#include "gc.hpp"
+#include "recorder.hpp"
+#include "replayer.hpp"
+#include "coroutinepool.hpp"
+#include "async.hpp"
+#include "task.hpp"
+#include "scheduler.hpp"
\ No newline at end of file
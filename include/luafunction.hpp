@@ -0,0 +1,370 @@
+#pragma once
+#include "lua.hpp"
+#include "object.h"
+#include "convert.hpp"
+#include "stackcheck.hpp"
+#include "exceptions.hpp"
+#include "policies.hpp"
+#include "statistics.hpp"
+#include "recorder.hpp"
+
+#include <initializer_list>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace lbind
+{
+	/*
+		A typed handle to a Lua function, for calling into Lua repeatedly from C++.
+
+			LuaFunction<int(int, int)> add(globals(state)["add"]);
+			int three = add(1, 2);
+
+		The function is resolved and pinned in the registry once, when the handle is created.
+		Each call only pushes the function and its arguments, and runs it with lua_pcall.
+		Errors raised by the function are thrown as LuaError.
+
+		LuaFunction can also be used as the parameter type of a bound function, so C++ APIs that
+		take callbacks accept Lua functions directly.
+	*/
+	namespace Detail
+	{
+		//Pops the error message on top of the stack and throws it as a LuaError.
+		void throwLuaError(lua_State * state);
+
+		template<typename R>
+		struct LuaResult
+		{
+			static const int count = 1;
+
+			//Throws BadCast if the result does not convert to R. It is popped either way.
+			static R pop(lua_State * state)
+			{
+				LBIND_STATISTIC(countConversions(state, -1, 1));
+				PopResult popped{ state };
+				return checkedIndexCast<R>(state, -1);
+			}
+
+			struct PopResult
+			{
+				~PopResult()
+				{
+					lua_pop(state, 1);
+				}
+
+				lua_State * state;
+			};
+		};
+
+		//Any value is an Object, so this never throws.
+		template<>
+		struct LuaResult<Object>
+		{
+			static const int count = 1;
+
+			static Object pop(lua_State * state)
+			{
+				LBIND_STATISTIC(countConversions(state, -1, 1));
+				Object result = Object::fromStack(state, -1);
+				lua_pop(state, 1);
+
+				return result;
+			}
+		};
+
+		template<>
+		struct LuaResult<void>
+		{
+			static const int count = 0;
+
+			static void pop(lua_State *)
+			{}
+		};
+	}
+
+	template<typename Signature>
+	class LuaFunction;
+
+	template<typename R, typename... Args>
+	class LuaFunction<R(Args...)>
+	{
+	public:
+		LuaFunction()
+		{}
+
+		explicit LuaFunction(const Object& fn)
+			:function(fn)
+		{
+			if (fn.type() != LUA_TFUNCTION)
+			{
+				throw BindingError("LuaFunction must be created from a function");
+			}
+		}
+
+		template<typename K, typename O>
+		explicit LuaFunction(const Detail::ObjectProxy<K, O>& proxy)
+			:LuaFunction(proxy.operator Object())
+		{}
+
+		template<typename O, typename... K>
+		explicit LuaFunction(const Detail::PathProxy<O, K...>& proxy)
+			:LuaFunction(proxy.operator Object())
+		{}
+
+		R operator()(Args... args) const
+		{
+			lua_State * state = function.state();
+			if (!state)
+			{
+				throw BindingError("Cannot call an empty LuaFunction");
+			}
+
+			StackCheck check(state, 0, 0);
+
+			//The function, and then one slot per argument.
+			if (!lua_checkstack(state, sizeof...(Args) + 1))
+			{
+				throw LuaError("Not enough stack space to call a Lua function");
+			}
+
+			int top = lua_gettop(state);
+			try
+			{
+				lua_rawgeti(state, LUA_REGISTRYINDEX, function.index());
+				(void)std::initializer_list<int>{(Convert<typename Undecorate<Args>::type>::to(state, args), 0)...};
+			}
+			catch (...)
+			{
+				//An argument that can not be converted, so the call never happens.
+				lua_settop(state, top);
+				throw;
+			}
+
+			Detail::RecordedLuaCall recorded(state, sizeof...(Args), Detail::LuaResult<R>::count);
+			LBIND_STATISTIC(Detail::LuaCallTimer timer(state, sizeof...(Args)));
+			if (lua_pcall(state, sizeof...(Args), Detail::LuaResult<R>::count, 0) != LUA_OK)
+			{
+				Detail::throwLuaError(state);
+			}
+
+			return Detail::LuaResult<R>::pop(state);
+		}
+
+		bool valid() const
+		{
+			return function.state() != nullptr;
+		}
+
+		const Object& object() const
+		{
+			return function;
+		}
+	private:
+		Object function;
+	};
+
+	template<typename R, typename... Args>
+	struct Convert<LuaFunction<R(Args...)>, void>
+	{
+		typedef LuaFunction<R(Args...)> type;
+		typedef boost::false_type is_primitive;
+
+		static type&& forward(type&& t)
+		{
+			return std::move(t);
+		}
+
+		template<typename T>
+		static T&& universal(type&& t)
+		{
+			return static_cast<T&&>(t);
+		}
+
+		//Anything but a function fails to convert, so overloads taking other types can be tried.
+		static int from(lua_State * state, int index, type& out)
+		{
+			if (lua_type(state, index) != LUA_TFUNCTION)
+			{
+				return -1;
+			}
+
+			//Held through the main thread, since state may be a coroutine that is collected or
+			//reused long before the function is called.
+			lua_rawgeti(state, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+			lua_State * main = lua_tothread(state, -1);
+			lua_pop(state, 1);
+
+			lua_pushvalue(state, index);
+			out = type(Object(main, luaL_ref(state, LUA_REGISTRYINDEX)));
+			return 1;
+		}
+
+		static int to(lua_State * state, const type& in)
+		{
+			return Convert<Object>::to(state, in.object());
+		}
+	};
+
+	struct BatchError
+	{
+		size_t index;
+		std::string message;
+	};
+
+	//The outcome of callBatch: how many calls ran, and which of them failed.
+	struct BatchResult
+	{
+		BatchResult()
+			:calls(0)
+		{}
+
+		bool ok() const
+		{
+			return errors.empty();
+		}
+
+		size_t calls;
+		std::vector<BatchError> errors;
+	};
+
+	namespace Detail
+	{
+		template<typename... Args, size_t... I>
+		void pushTuple(lua_State * state, const std::tuple<Args...>& args, std::index_sequence<I...>)
+		{
+			(void)std::initializer_list<int>{(Convert<typename Undecorate<Args>::type>::to(state, std::get<I>(args)), 0)...};
+		}
+
+		inline bool keepGoing(stop_on_error_t)
+		{
+			return false;
+		}
+
+		inline bool keepGoing(continue_on_error_t)
+		{
+			return true;
+		}
+
+		template<typename R, typename... Args, typename Tuple, typename Out, typename Policy>
+		BatchResult callBatch(const LuaFunction<R(Args...)>& fn, const Tuple * args, size_t count, Out&& out, Policy policy)
+		{
+			BatchResult result;
+
+			lua_State * state = fn.object().state();
+			if (!state)
+			{
+				throw BindingError("Cannot call an empty LuaFunction");
+			}
+
+			StackCheck check(state, 0, 0);
+
+			//The function is pushed once, and copied down for every call.
+			if (!lua_checkstack(state, sizeof...(Args) + 2))
+			{
+				throw LuaError("Not enough stack space to call a Lua function");
+			}
+
+			int top = lua_gettop(state);
+			lua_rawgeti(state, LUA_REGISTRYINDEX, fn.object().index());
+			int function = lua_gettop(state);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				try
+				{
+					lua_pushvalue(state, function);
+					pushTuple(state, args[i], std::index_sequence_for<Args...>());
+				}
+				catch (...)
+				{
+					//An argument that can not be converted, which ends the batch like operator().
+					lua_settop(state, top);
+					throw;
+				}
+
+				result.calls++;
+				RecordedLuaCall recorded(state, sizeof...(Args), LuaResult<R>::count);
+				LBIND_STATISTIC(LuaCallTimer timer(state, sizeof...(Args)));
+				if (lua_pcall(state, sizeof...(Args), LuaResult<R>::count, 0) != LUA_OK)
+				{
+					const char * message = lua_tostring(state, -1);
+					result.errors.push_back(BatchError{i, message ? message : "(error object is not a string)"});
+					lua_pop(state, 1);
+
+					if (!keepGoing(policy))
+					{
+						break;
+					}
+
+					continue;
+				}
+
+				//A result that does not convert fails its call, like an error raised by it.
+				try
+				{
+					out(state);
+				}
+				catch (const BadCast& e)
+				{
+					result.errors.push_back(BatchError{i, e.what()});
+					if (!keepGoing(policy))
+					{
+						break;
+					}
+				}
+				catch (...)
+				{
+					lua_settop(state, top);
+					throw;
+				}
+			}
+
+			lua_pop(state, 1);
+			return result;
+		}
+	}
+
+	/*
+		Calls fn once for every tuple of arguments, collecting the results into out.
+
+			std::vector<std::tuple<int, int>> events = ...;
+			std::vector<int> results;
+			BatchResult r = callBatch(handler, events, results, continue_on_error);
+
+		Unlike calling fn in a loop, the stack is reserved and the function is pushed only once.
+		Each call is still protected on its own, so a failing call is reported in the result, and either
+		stops the batch (stop_on_error, the default) or is skipped (continue_on_error). A result
+		that does not convert to R counts as a failure too. Results of calls that fail are not
+		appended to out.
+	*/
+	template<typename R, typename... Args, typename Policy = stop_on_error_t>
+	BatchResult callBatch(const LuaFunction<R(Args...)>& fn, const std::tuple<typename Undecorate<Args>::type...> * args, size_t count, std::vector<R>& out, Policy policy = stop_on_error)
+	{
+		out.reserve(out.size() + count);
+		return Detail::callBatch(fn, args, count, [&out](lua_State * state)
+		{
+			out.push_back(Detail::LuaResult<R>::pop(state));
+		}, policy);
+	}
+
+	template<typename R, typename... Args, typename Policy = stop_on_error_t>
+	BatchResult callBatch(const LuaFunction<R(Args...)>& fn, const std::vector<std::tuple<typename Undecorate<Args>::type...>>& args, std::vector<R>& out, Policy policy = stop_on_error)
+	{
+		return callBatch(fn, args.data(), args.size(), out, policy);
+	}
+
+	//Functions that return nothing need no output.
+	template<typename... Args, typename Policy = stop_on_error_t>
+	BatchResult callBatch(const LuaFunction<void(Args...)>& fn, const std::tuple<typename Undecorate<Args>::type...> * args, size_t count, Policy policy = stop_on_error)
+	{
+		return Detail::callBatch(fn, args, count, [](lua_State *)
+		{}, policy);
+	}
+
+	template<typename... Args, typename Policy = stop_on_error_t>
+	BatchResult callBatch(const LuaFunction<void(Args...)>& fn, const std::vector<std::tuple<typename Undecorate<Args>::type...>>& args, Policy policy = stop_on_error)
+	{
+		return callBatch(fn, args.data(), args.size(), policy);
+	}
+}
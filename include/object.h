@@ -6,6 +6,8 @@
 #include <boost/utility/string_ref.hpp>
 #include <boost/mpl/logical.hpp>
 #include <iostream>
+#include <tuple>
+#include <utility>
 
 namespace lbind
 {
@@ -20,13 +22,34 @@ namespace lbind
 	*/
 
 	class Object;
+	class Key;
 	namespace Detail
 	{
 		template<typename T, typename O>
 		class ObjectProxy;
 
+		template<typename Obj, typename... Keys>
+		class PathProxy;
+
+		//Proxies are assigned from by value, never converted as a bound class.
+		template<typename T>
+		struct IsProxy : boost::false_type
+		{};
+
+		template<typename T, typename O>
+		struct IsProxy<ObjectProxy<T, O>> : boost::true_type
+		{};
+
+		template<typename O, typename... K>
+		struct IsProxy<PathProxy<O, K...>> : boost::true_type
+		{};
+
 		class Iterator;
-		class StackIterator;
+
+		//Raw access through an interned Key, see Key below. Only tables can be assigned to;
+		//setIndexed pops the value and throws BindingError for anything else.
+		int pushIndexed(lua_State * state, int t, const Key * key);
+		void setIndexed(lua_State * state, int t, const Key * key);
 	}
 
 	//Basically an object, but is on the stack.
@@ -34,15 +57,17 @@ namespace lbind
 	{
 		friend class Detail::ObjectProxy<int, StackObject>;
 		friend class Detail::ObjectProxy<boost::string_ref, StackObject>;
+		friend class Detail::ObjectProxy<const Key *, StackObject>;
 	public:
 		static StackObject fromStack(lua_State * state, int ind);
 
 		StackObject(lua_State * interpreter, int index);
-		typedef Detail::StackIterator iterator;
+		typedef Detail::Iterator iterator;
 
 		//Upon construction, this object must be at the top of the stack.
 		Detail::ObjectProxy<int, StackObject> operator[](int i);
 		Detail::ObjectProxy<boost::string_ref, StackObject> operator[](boost::string_ref k);
+		Detail::ObjectProxy<const Key *, StackObject> operator[](const Key& k);
 
 		//Pushes this object onto the stack
 		StackObject push();
@@ -57,6 +82,7 @@ namespace lbind
 	private:
 		int stackPush(int i) const;
 		int stackPush(boost::string_ref i) const;
+		int stackPush(const Key * i) const;
 
 		template<typename T>
 		void stackSet(int key, const T& t)
@@ -66,6 +92,13 @@ namespace lbind
 			lua_seti(interpreter, canonical, key);
 		}
 
+		template<typename T>
+		void stackSet(const Key * key, const T& t)
+		{
+			Convert<T>::to(interpreter, t);
+			Detail::setIndexed(interpreter, canonical, key);
+		}
+
 		template<typename T>
 		void stackSet(boost::string_ref key, const T& t)
 		{
@@ -80,26 +113,39 @@ namespace lbind
 		int canonical;
 	};
 
-	//TODO: THIS LEAKS REFERENCES.
+	//A handle to a value in the registry. Copies share the same registry slot through a
+	//reference count kept in the InternalState, and the slot is unref'd when the last copy
+	//is destroyed, so an Object must not outlive lbind::close for its state.
+	//Well-known registry indices (such as LUA_RIDX_GLOBALS) and nil are not reference counted.
 	//TODO: CALL
 	class Object
 	{
 		friend class Detail::ObjectProxy<int, Object>;
 		friend class Detail::ObjectProxy<boost::string_ref, Object>;
+		friend class Detail::ObjectProxy<const Key *, Object>;
 	public:
 		static Object fromStack(lua_State * state, int ind);
 
 		typedef Detail::Iterator iterator;
 
+		//Takes ownership of a registry reference created with luaL_ref.
 		Object(lua_State * state, int index);
 		Object();
 
+		Object(const Object& other);
+		Object(Object&& other);
+		~Object();
+
+		Object& operator=(Object other);
+		void swap(Object& other);
+
 		//Pushes this object onto the stack.
 		StackObject push();
 		void pop(StackObject&);
 
 		Detail::ObjectProxy<int, Object> operator[](int i);
 		Detail::ObjectProxy<boost::string_ref, Object> operator[](boost::string_ref k);
+		Detail::ObjectProxy<const Key *, Object> operator[](const Key& k);
 
 		int type() const;
 		int index() const;
@@ -110,6 +156,7 @@ namespace lbind
 	private:
 		int stackPush(int i) const;
 		int stackPush(boost::string_ref i) const;
+		int stackPush(const Key * i) const;
 
 		template<typename T>
 		void stackSet(int key, const T& t)
@@ -121,6 +168,25 @@ namespace lbind
 			lua_pop(interpreter, 1);
 		}
 
+		template<typename T>
+		void stackSet(const Key * key, const T& t)
+		{
+			lua_rawgeti(interpreter, LUA_REGISTRYINDEX, ind);
+			Convert<T>::to(interpreter, t);
+
+			try
+			{
+				Detail::setIndexed(interpreter, -2, key);
+			}
+			catch (...)
+			{
+				lua_pop(interpreter, 1);
+				throw;
+			}
+
+			lua_pop(interpreter, 1);
+		}
+
 		template<typename T>
 		void stackSet(boost::string_ref key, const T& t)
 		{
@@ -133,10 +199,70 @@ namespace lbind
 			lua_pop(interpreter, 1);
 		}
 
+		bool owned() const;
+		void retain();
+		void release();
+
 		lua_State * interpreter;
 		int ind;
 	};
 
+	/*
+		A string interned once per state and anchored in the registry, for keys that are used
+		over and over:
+
+			Key position(state, "position");
+			double x = entity[position];
+
+		Pushing a Key is a lua_rawgeti instead of hashing and interning the string again, and
+		lookups through it use lua_rawget/lua_rawset, so metamethods are not invoked. Keys can
+		also be returned from bound functions to cheaply push constant strings such as enum names.
+	*/
+	class Key
+	{
+	public:
+		Key(lua_State * state, boost::string_ref name);
+		Key();
+
+		//Pushes the string onto the given state, or any thread of it.
+		void push(lua_State * state) const;
+
+		int index() const;
+		lua_State * state() const;
+	private:
+		Object string;
+	};
+
+	template<>
+	struct Convert<Key, void>
+	{
+		typedef Key type;
+		typedef boost::true_type is_primitive;
+
+		static Key&& forward(type&& t)
+		{
+			return std::move(t);
+		}
+
+		template<typename T>
+		static T&& universal(type&& t)
+		{
+			return static_cast<T&&>(t);
+		}
+
+		//Keys are only ever created from C++.
+		static int from(lua_State * state, int index, type& out)
+		{
+			return -1;
+		}
+
+		static int to(lua_State * state, const type& in)
+		{
+			in.push(state);
+			return 1;
+		}
+	};
+
 	template<>
 	struct Convert<Object, void>
 	{
@@ -160,9 +286,9 @@ namespace lbind
 			return 1;
 		}
 
+		//The registry is shared by every thread of a state, so this can push onto a coroutine.
 		static int to(lua_State * state, const type& in)
 		{
-			assert(state = in.state());
 			lua_rawgeti(state, LUA_REGISTRYINDEX, in.index());
 			return 1;
 		}
@@ -257,6 +383,57 @@ namespace lbind
 		return *result;
 	}
 
+	//As indexCast, but throws BadCast if the value can not be converted to T, rather than
+	//leaving the result default or null.
+	template<typename T>
+	T checkedIndexCast(lua_State * s, int i, typename boost::enable_if<typename Convert<T>::is_primitive>::type * = nullptr)
+	{
+		T result;
+		if (Convert<T>::from(s, i, result) < 0)
+		{
+			throw BadCast("Value could not be converted to the requested type");
+		}
+
+		return result;
+	}
+
+	template<typename T>
+	T checkedIndexCast(lua_State * s, int i, typename boost::enable_if<Detail::IsPointerToNonprimitive<T>>::type * = nullptr)
+	{
+		T result = nullptr;
+		if (Convert<T>::from(s, i, result) < 0)
+		{
+			throw BadCast("Value could not be converted to the requested type");
+		}
+
+		return result;
+	}
+
+	template<typename T>
+	T checkedIndexCast(lua_State * s, int i, typename boost::enable_if<Detail::IsNonprimitiveReference<T>>::type * = nullptr)
+	{
+		typedef typename boost::remove_reference<T>::type base;
+		base * result = nullptr;
+		if (Convert<base *>::from(s, i, result) < 0 || !result)
+		{
+			throw BadCast("Value could not be converted to the requested type");
+		}
+
+		return *result;
+	}
+
+	template<typename T>
+	T checkedIndexCast(lua_State * s, int i, typename boost::enable_if<Detail::IsNonprimitiveValue<T>>::type * = nullptr)
+	{
+		T * result = nullptr;
+		if (Convert<T *>::from(s, i, result) < 0 || !result)
+		{
+			throw BadCast("Value could not be converted to the requested type");
+		}
+
+		return *result;
+	}
+
 	template<typename T>
 	T cast(const Object& o)
 	{
@@ -332,7 +509,7 @@ namespace lbind
 
 			template<typename U>
 			typename boost::disable_if<
-				boost::is_same<U, StackObject>,
+				boost::mpl::or_<boost::is_same<U, StackObject>, IsProxy<U>>,
 				ObjectProxy&>::type
 			operator=(const U& u)
 			{
@@ -342,6 +519,18 @@ namespace lbind
 				return *this;
 			}
 
+			template<typename K, typename O>
+			ObjectProxy& operator=(const ObjectProxy<K, O>& other)
+			{
+				return *this = other.operator Object();
+			}
+
+			template<typename O, typename... K>
+			ObjectProxy& operator=(const PathProxy<O, K...>& other)
+			{
+				return *this = other.operator Object();
+			}
+
 			ObjectProxy& operator=(const ObjectProxy& other)
 			{
 				int pop = boost::is_same<Obj, StackObject>::value ? 1 : 2;
@@ -351,55 +540,216 @@ namespace lbind
 				object->stackSet(key, StackObject(other.object->state(), -1));
 				return *this;
 			}
+
+			//Chained access, see PathProxy.
+			PathProxy<Obj, T, int> operator[](int i) const
+			{
+				return PathProxy<Obj, T, int>(object, std::make_tuple(key, i));
+			}
+
+			PathProxy<Obj, T, boost::string_ref> operator[](boost::string_ref k) const
+			{
+				return PathProxy<Obj, T, boost::string_ref>(object, std::make_tuple(key, k));
+			}
+
+			PathProxy<Obj, T, const Key *> operator[](const Key& k) const
+			{
+				return PathProxy<Obj, T, const Key *>(object, std::make_tuple(key, &k));
+			}
 		private:
 			T key;
 			Obj * object;
 		};
 
-		class Iterator
+		//Pushes t[key] for the value at index t, invoking metamethods. Returns the type of the result.
+		inline int pushIndexed(lua_State * state, int t, int key)
 		{
-		public:
-			explicit Iterator(Object * o);
-			Iterator();
+			return lua_geti(state, t, key);
+		}
 
-			Iterator& operator++();
-			Iterator operator++(int);
+		inline int pushIndexed(lua_State * state, int t, boost::string_ref key)
+		{
+			assert(key[key.size()] == 0);
+			return lua_getfield(state, t, key.data());
+		}
 
-			Object operator*();
-			Object key();
+		//Pops a value and stores it in t[key].
+		inline void setIndexed(lua_State * state, int t, int key)
+		{
+			lua_seti(state, t, key);
+		}
 
-			bool operator==(const Iterator& other);
-			bool operator!=(const Iterator& other);
-		private:
-			Object * o;
+		inline void setIndexed(lua_State * state, int t, boost::string_ref key)
+		{
+			assert(key[key.size()] == 0);
+			lua_setfield(state, t, key.data());
+		}
 
-			Object currentIndex;
-			Object value;
-			int hasNext;
-			int increments;
-		};
+		inline void pushRoot(const Object * o)
+		{
+			lua_rawgeti(o->state(), LUA_REGISTRYINDEX, o->index());
+		}
 
-		class StackIterator
+		inline void pushRoot(const StackObject * o)
 		{
+			lua_pushvalue(o->state(), o->index());
+		}
+
+		/*
+			A chain of keys below an Object or StackObject, such as cfg["server"]["limits"]["rps"].
+			The path is part of the type and is only walked when the proxy is read or assigned,
+			in one sequence of lua_getfield/lua_geti calls on the stack, so intermediate tables
+			never get registry references of their own.
+
+			Reading through a level that is not a table or userdata yields nil. Assigning through
+			one throws a BindingError.
+		*/
+		template<typename Obj, typename... Keys>
+		class PathProxy
+		{
+			typedef std::tuple<Keys...> path_type;
+			static const size_t depth = sizeof...(Keys);
 		public:
-			explicit StackIterator(StackObject * o);
-			StackIterator();
+			PathProxy(Obj * root, const path_type& path)
+				:root(root)
+				,path(path)
+			{}
+
+			PathProxy<Obj, Keys..., int> operator[](int i) const
+			{
+				return PathProxy<Obj, Keys..., int>(root, std::tuple_cat(path, std::make_tuple(i)));
+			}
 
-			StackIterator& operator++();
-			StackIterator operator++(int);
+			PathProxy<Obj, Keys..., boost::string_ref> operator[](boost::string_ref k) const
+			{
+				return PathProxy<Obj, Keys..., boost::string_ref>(root, std::tuple_cat(path, std::make_tuple(k)));
+			}
+
+			PathProxy<Obj, Keys..., const Key *> operator[](const Key& k) const
+			{
+				return PathProxy<Obj, Keys..., const Key *>(root, std::tuple_cat(path, std::make_tuple(&k)));
+			}
+
+			template<typename U, typename Enable = typename boost::disable_if<boost::is_same<U, StackObject>, void>::type>
+			operator U() const
+			{
+				lua_State * state = root->state();
+				StackCheck check(state, 0, 0);
+
+				int top = lua_gettop(state);
+				push();
+
+				U result = indexCast<U>(state, -1);
+				lua_settop(state, top);
+				return result;
+			}
+
+			operator Object() const
+			{
+				lua_State * state = root->state();
+				StackCheck check(state, 0, 0);
+
+				int top = lua_gettop(state);
+				push();
+
+				Object result = Object::fromStack(state, -1);
+				lua_settop(state, top);
+				return result;
+			}
+
+			template<typename U>
+			typename boost::disable_if<
+				boost::mpl::or_<boost::is_same<U, StackObject>, IsProxy<U>>,
+				PathProxy&>::type
+			operator=(const U& u)
+			{
+				lua_State * state = root->state();
+				StackCheck check(state, 0, 0);
+
+				int top = lua_gettop(state);
+				if (!walk(std::make_index_sequence<depth - 1>()) || !indexable())
+				{
+					lua_settop(state, top);
+					throw BindingError("Cannot assign through a path that does not exist");
+				}
+
+				Convert<U>::to(state, u);
+				try
+				{
+					setIndexed(state, -2, std::get<depth - 1>(path));
+				}
+				catch (...)
+				{
+					lua_settop(state, top);
+					throw;
+				}
+
+				lua_settop(state, top);
+				return *this;
+			}
+
+			PathProxy& operator=(const PathProxy& other)
+			{
+				Object value = other;
+				return *this = value;
+			}
 
-			StackObject operator*();
-			StackObject key();
+			template<typename O, typename... K>
+			PathProxy& operator=(const PathProxy<O, K...>& other)
+			{
+				Object value = other;
+				return *this = value;
+			}
 
-			bool operator==(const StackIterator& other);
-			bool operator!=(const StackIterator& other);
+			template<typename K, typename O>
+			PathProxy& operator=(const ObjectProxy<K, O>& other)
+			{
+				Object value = other;
+				return *this = value;
+			}
 		private:
-			StackObject * o;
+			//Pushes the value at the end of the path, or nil if the path does not exist.
+			void push() const
+			{
+				if (!walk(std::make_index_sequence<depth>()))
+				{
+					lua_pushnil(root->state());
+				}
+			}
+
+			//Pushes the root and then every level named by the given keys. Returns false if a level
+			//could not be indexed, in which case the stack holds the levels pushed so far.
+			template<size_t... I>
+			bool walk(std::index_sequence<I...>) const
+			{
+				pushRoot(root);
+
+				bool found = true;
+				(void)std::initializer_list<int>{(found = found && step(std::get<I>(path)), 0)...};
+
+				return found;
+			}
+
+			template<typename K>
+			bool step(const K& key) const
+			{
+				if (!indexable())
+				{
+					return false;
+				}
+
+				pushIndexed(root->state(), -1, key);
+				return true;
+			}
+
+			bool indexable() const
+			{
+				int type = lua_type(root->state(), -1);
+				return type == LUA_TTABLE || type == LUA_TUSERDATA;
+			}
 
-			int currentIndex;
-			int value;
-			int hasNext;
-			int increments;
+			Obj * root;
+			path_type path;
 		};
 	}
 
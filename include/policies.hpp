@@ -11,7 +11,16 @@ namespace lbind
 	struct ignore_return_t
 	{};
 
+	//Batched calls either stop at the first error, or record it and keep going.
+	struct stop_on_error_t
+	{};
+
+	struct continue_on_error_t
+	{};
+
 	extern null_policy_t null_policy;
 	extern returns_self_t returns_self;
 	extern ignore_return_t ignore_return;
+	extern stop_on_error_t stop_on_error;
+	extern continue_on_error_t continue_on_error;
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+#include <lua.hpp>
+#include <boost/cstdint.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace lbind
+{
+	namespace Detail
+	{
+		struct FunctionBase;
+	}
+
+	/*
+		A sampling profiler for a lua_State, producing folded stacks for flamegraph tools.
+
+			Profiler profiler(state, std::chrono::microseconds(500));
+			profiler.start();
+			...
+			profiler.stop();
+			profiler.writeFolded(std::ofstream("lua.folded"));
+
+		A timer thread arms a count hook every period, which fires on the next VM instruction,
+		walks the Lua stack and disarms itself. Bound C++ functions are marked on entry and exit in
+		FunctionBase::apply, so ticks that land inside one are charged to it, on top of the stack
+		that called it, instead of to whatever Lua code runs next.
+
+		Overhead is bounded by the period: the VM only leaves its fast path once per sample, and
+		bound calls pay two relaxed stores. Weights in the output are sample counts.
+
+		Samples are taken on the thread the profiler was created for, so time in a coroutine is
+		charged to whoever resumed it. Only one profiler can run on a state at a time, and the
+		results should only be read once it is stopped.
+	*/
+	class Profiler
+	{
+	public:
+		explicit Profiler(lua_State * state, std::chrono::microseconds period = std::chrono::microseconds(1000));
+		~Profiler();
+
+		Profiler(const Profiler&) = delete;
+		Profiler& operator=(const Profiler&) = delete;
+
+		//Throws BindingError if another profiler is already running on the state.
+		void start();
+		void stop();
+		bool running() const;
+
+		size_t samples() const;
+		void clear();
+
+		//One line per distinct stack: frames separated by ';', then the sample count.
+		std::string folded() const;
+		void writeFolded(std::ostream& out) const;
+	private:
+		static void hook(lua_State * state, lua_Debug * ar);
+		void sample(lua_State * state);
+		void tick();
+		std::string stack(lua_State * state) const;
+
+		lua_State * state;
+		std::chrono::microseconds period;
+		bool active;
+		size_t sampleCount;
+
+		//Shared with the timer thread.
+		std::atomic<boost::uint32_t> ticksInBound;
+		std::atomic<Detail::FunctionBase *> bound;
+
+		std::thread timer;
+		std::mutex lock;
+		std::condition_variable wake;
+		bool stopping;
+
+		std::unordered_map<std::string, boost::uint64_t> stacks;
+	};
+}
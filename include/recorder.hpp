@@ -0,0 +1,173 @@
+#pragma once
+#include <lua.hpp>
+#include <boost/cstdint.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#include "internal.hpp"
+
+namespace lbind
+{
+	namespace Detail
+	{
+		struct FunctionBase;
+	}
+
+	/*
+		Records the calls that cross the binding layer of a state into a compact binary trace,
+		which a Replayer can later drive against a fresh state.
+
+			Recorder recorder(state, "session.lbtrace");
+			recorder.start();
+			...
+			recorder.stop();
+
+		Two kinds of calls are recorded, as they start and as they return:
+			- Bound C++ functions called from Lua, through FunctionBase::apply.
+			- Lua functions called from C++, through call<R>, LuaFunction and callBatch.
+
+		Each call records the binding, a timestamp and its arguments. Nil, booleans, integers,
+		numbers and strings are recorded by value. Other values only record their type, and bound
+		objects their class name. Strings longer than maxString are cut short.
+
+		Bindings are identified by their place in the state's registration order, along with the
+		name they were registered under, so a state bound by the same code finds the same functions.
+		Lua functions are named by where they were defined, as "source:line". Names are written
+		once, the first time they are seen.
+
+		Recording is off until start is called, and costs a pointer check per call while off.
+		Only one recorder can run on a state at a time.
+
+		The format is a header of the magic "LBTR" and a version, followed by records that each
+		start with a tag byte. Integers are LEB128 varints, signed ones zigzag encoded, and
+		timestamps are nanoseconds since the previous record.
+	*/
+	class Recorder
+	{
+	public:
+		enum Tag
+		{
+			//A name for an id: kind, id, length, bytes. Binding ids are registration indices.
+			Define = 'D',
+
+			//A call starting: timestamp, id, argument count, arguments. Call records are numbered
+			//from 1 in the order they are written.
+			BindingCall = 'C',
+			LuaCall = 'L',
+
+			//A call returning: timestamp, sequence number of its call record, result count.
+			Return = 'R'
+		};
+
+		enum Kind
+		{
+			Binding,
+			LuaFunction,
+			Class
+		};
+
+		enum ValueTag
+		{
+			Nil,
+			False,
+			True,
+			Integer,
+			Number,
+			String,
+			Table,
+			Function,
+			Userdata,
+			LightUserdata,
+			Thread
+		};
+
+		static const boost::uint32_t version = 1;
+		static const size_t maxString = 1024;
+
+		Recorder(lua_State * state, const std::string& path);
+		~Recorder();
+
+		Recorder(const Recorder&) = delete;
+		Recorder& operator=(const Recorder&) = delete;
+
+		//Throws BindingError if another recorder is already running on the state, or if the
+		//file can not be written.
+		void start();
+		void stop();
+		bool running() const;
+
+		//Call records written so far.
+		size_t calls() const;
+
+		//Called through the binding layer. The arguments are the top count values on the stack,
+		//and a Lua function is just below them. Both return the sequence number of the call.
+		size_t enterBinding(lua_State * state, Detail::FunctionBase * function, int count);
+		size_t enterLua(lua_State * state, int count);
+		void leave(size_t sequence, int results);
+	private:
+		boost::uint32_t define(Kind kind, const void * key, boost::uint32_t id, const std::string& name);
+		boost::uint32_t classOf(lua_State * state, int index);
+		void defineClasses(lua_State * state, int first, int count);
+		void writeArguments(lua_State * state, int first, int count);
+		void writeTimestamp();
+		void writeVarint(boost::uint64_t value);
+		void writeSigned(boost::int64_t value);
+		void writeString(const char * text, size_t length);
+		void flush();
+
+		lua_State * state;
+		std::string path;
+		std::ofstream file;
+		bool active;
+
+		std::string buffer;
+		std::chrono::steady_clock::time_point last;
+
+		std::unordered_map<const void *, boost::uint32_t> ids[3];
+		size_t sequence;
+	};
+
+	namespace Detail
+	{
+		//The recorder running on a state, if any. There is none once lbind::close has run.
+		inline Recorder * runningRecorder(lua_State * state)
+		{
+			InternalState * internal = getInternalState(state);
+			return internal ? internal->recorder : nullptr;
+		}
+
+		//Records a call into Lua with count arguments on the top of the stack, for as long as it
+		//is in scope.
+		struct RecordedLuaCall
+		{
+			RecordedLuaCall(lua_State * state, int count, int results)
+				:state(state)
+				,results(results)
+				,sequence(0)
+			{
+				if (Recorder * recorder = runningRecorder(state))
+				{
+					sequence = recorder->enterLua(state, count);
+				}
+			}
+
+			~RecordedLuaCall()
+			{
+				if (sequence)
+				{
+					if (Recorder * recorder = runningRecorder(state))
+					{
+						recorder->leave(sequence, results);
+					}
+				}
+			}
+
+			lua_State * state;
+			int results;
+			size_t sequence;
+		};
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <lua.hpp>
+#include <boost/cstdint.hpp>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+#include "recorder.hpp"
+
+namespace lbind
+{
+	//The outcome of a replay.
+	struct ReplayResult
+	{
+		ReplayResult()
+			:calls(0)
+			,failed(0)
+			,skipped(0)
+			,elapsed(0)
+			,recorded(0)
+		{}
+
+		//Calls made, and of those, how many raised an error.
+		size_t calls;
+		size_t failed;
+
+		//Calls that could not be made, because their function was not found.
+		size_t skipped;
+
+		//How long the calls took to replay, and how long the same calls took when recorded.
+		std::chrono::nanoseconds elapsed;
+		std::chrono::nanoseconds recorded;
+	};
+
+	/*
+		Replays a trace written by a Recorder against another state, one bound by the same code.
+
+			Replayer replayer("session.lbtrace");
+			replayer.substitute("Int", [](lua_State * s) { call<void>(globals(s)["Int"], 0); });
+
+			ReplayResult result = replayer.replay(state);
+
+		Bindings are found by their registration index in the new state, as long as the name there
+		matches the recorded one. Lua functions are only called if they are mapped to a function in
+		the new state by their "source:line" name; calls they made into bindings are replayed
+		directly instead.
+
+		Only the outermost calls are made: a call made from within a replayed call happens again on
+		its own, or not at all, as the new state decides.
+
+		Arguments recorded by value are pushed as they were. Tables are replaced by empty tables,
+		bound objects by whatever the substitute for their class pushes, and anything else by nil.
+	*/
+	class Replayer
+	{
+	public:
+		//Throws BindingError if the file can not be read or is not a trace.
+		explicit Replayer(const std::string& path);
+
+		//Call records in the trace, of either kind.
+		size_t calls() const;
+
+		//Calls the function for calls recorded under name, which is a binding name or the
+		//"source:line" of a Lua function. The function must belong to the replayed state, which
+		//must outlive the replayer.
+		void map(const std::string& name, Object function);
+
+		//Pushes a stand-in for objects of the named class. It must push exactly one value.
+		void substitute(const std::string& className, std::function<void(lua_State *)> push);
+
+		ReplayResult replay(lua_State * state) const;
+	private:
+		struct Value
+		{
+			Recorder::ValueTag tag;
+			lua_Integer integer;
+			lua_Number number;
+
+			//The string, or the class name of a bound object.
+			std::string text;
+		};
+
+		struct Call
+		{
+			Recorder::Tag tag;
+			boost::uint32_t id;
+
+			//The innermost call that was running when this one started, as an index into
+			//records plus one, or 0 if there was none.
+			size_t parent;
+
+			std::chrono::nanoseconds start;
+			std::chrono::nanoseconds duration;
+
+			std::vector<Value> arguments;
+		};
+
+		//Pushes what a call should call, or returns false if there is nothing.
+		bool push(lua_State * state, const Call& call) const;
+		void push(lua_State * state, const Value& value) const;
+
+		std::vector<Call> records;
+		std::unordered_map<boost::uint32_t, std::string> names[3];
+
+		std::unordered_map<std::string, Object> mapped;
+		std::unordered_map<std::string, std::function<void(lua_State *)>> substitutes;
+	};
+}
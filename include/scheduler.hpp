@@ -0,0 +1,195 @@
+#pragma once
+#include <lua.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "convert.hpp"
+#include "luafunction.hpp"
+#include "state.hpp"
+
+namespace lbind
+{
+	namespace Detail
+	{
+		//Work for one of a Scheduler's states.
+		class Job
+		{
+		public:
+			virtual ~Job()
+			{}
+
+			virtual void run(lua_State * state) = 0;
+		};
+
+		template<typename R>
+		void fulfil(std::promise<R>& promise, lua_State * state)
+		{
+			promise.set_value(LuaResult<R>::pop(state));
+		}
+
+		inline void fulfil(std::promise<void>& promise, lua_State *)
+		{
+			promise.set_value();
+		}
+
+		//Calls a global function with arguments copied when the job was submitted.
+		template<typename R, typename... Args>
+		class ScriptJob : public Job
+		{
+		public:
+			template<typename... A>
+			ScriptJob(std::string function, A&&... args)
+				:function(std::move(function))
+				,arguments(std::forward<A>(args)...)
+			{}
+
+			std::future<R> future()
+			{
+				return promise.get_future();
+			}
+
+			void run(lua_State * state)
+			{
+				int top = lua_gettop(state);
+				try
+				{
+					//The function, and then one slot per argument.
+					if (!lua_checkstack(state, sizeof...(Args) + 1))
+					{
+						throw LuaError("Not enough stack space to call a Lua function");
+					}
+
+					lua_getglobal(state, function.c_str());
+					std::apply([state](const Args&... args) {
+						(void)std::initializer_list<int>{0, (Convert<typename Undecorate<Args>::type>::to(state, args), 0)...};
+					}, arguments);
+
+					Detail::RecordedLuaCall recorded(state, sizeof...(Args), LuaResult<R>::count);
+					LBIND_STATISTIC(Detail::LuaCallTimer timer(state, sizeof...(Args)));
+					if (lua_pcall(state, sizeof...(Args), LuaResult<R>::count, 0) != LUA_OK)
+					{
+						throwLuaError(state);
+					}
+
+					fulfil(promise, state);
+				}
+				catch (...)
+				{
+					lua_settop(state, top);
+					promise.set_exception(std::current_exception());
+				}
+			}
+		private:
+			std::string function;
+			std::tuple<Args...> arguments;
+			std::promise<R> promise;
+		};
+	}
+
+	struct SchedulerOptions
+	{
+		SchedulerOptions()
+			:workers(0)
+		{}
+
+		//0 is one per hardware thread.
+		size_t workers;
+
+		//For each worker's state.
+		StateOptions state;
+	};
+
+	/*
+		Runs scripted jobs on a pool of threads, each with a bound state of its own.
+
+			Scheduler scheduler([](lua_State * state) {
+				module(state).def("lookup", lookup).end();
+				luaL_dostring(state, handlers);
+			});
+
+			std::future<std::string> response = scheduler.submit<std::string>("handle", request);
+
+		A job calls a global function of whichever state picks it up, with the arguments it was
+		submitted with, and its future gets what the function returns or the exception the call
+		threw, such as a LuaError. Arguments are copied into the job, and converted on the worker.
+
+		States are created with newstate and set up on the constructing thread before any worker
+		starts, since registering bindings touches statics shared by every state. Jobs should
+		not rely on which state runs them, or on what earlier jobs left in it.
+
+		Each worker runs the jobs in its own queue oldest first. Submitting from one of the
+		workers queues the job there, and submitting from anywhere else spreads jobs over the
+		workers in turn. A worker with nothing to do steals the newest job from the back of
+		another's queue, away from the end its owner takes from, before it goes to sleep.
+
+		The destructor finishes every job already submitted, then closes the states.
+	*/
+	class Scheduler
+	{
+	public:
+		explicit Scheduler(std::function<void(lua_State *)> setup, const SchedulerOptions& options = SchedulerOptions());
+		~Scheduler();
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+
+		template<typename R, typename... Args>
+		std::future<R> submit(std::string function, Args&&... args)
+		{
+			typedef Detail::ScriptJob<R, typename std::decay<Args>::type...> Job;
+
+			std::unique_ptr<Job> job(new Job(std::move(function), std::forward<Args>(args)...));
+			std::future<R> result = job->future();
+
+			push(std::move(job));
+			return result;
+		}
+
+		size_t workers() const;
+
+		//Jobs taken from another worker's queue.
+		size_t stolen() const;
+
+		//Jobs submitted but not yet started.
+		size_t pending() const;
+	private:
+		struct Worker
+		{
+			lua_State * state;
+
+			std::mutex lock;
+			std::deque<std::unique_ptr<Detail::Job>> jobs;
+
+			std::thread thread;
+		};
+
+		void push(std::unique_ptr<Detail::Job> job);
+		void work(size_t index);
+
+		std::unique_ptr<Detail::Job> take(size_t index);
+		std::unique_ptr<Detail::Job> steal(size_t thief);
+
+		std::vector<std::unique_ptr<Worker>> pool;
+
+		std::atomic<size_t> queued;
+		std::atomic<size_t> next;
+		std::atomic<size_t> steals;
+
+		//Idle workers sleep here until there is work, or the scheduler is stopping.
+		std::mutex sleep;
+		std::condition_variable wake;
+		bool stopping;
+	};
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "lua.hpp"
+
+#include <cstddef>
+
+namespace lbind
+{
+	struct StateOptions
+	{
+		StateOptions()
+			:memoryLimit(0)
+			,arenaBlockSize(64 * 1024)
+			,openLibraries(true)
+		{}
+
+		//Allocations that would take live memory past this fail, and scripts see a memory error. 0 is unlimited.
+		size_t memoryLimit;
+
+		//Small allocations are carved out of blocks of this size.
+		size_t arenaBlockSize;
+
+		bool openLibraries;
+	};
+
+	struct MemoryUsage
+	{
+		size_t live;
+		size_t peak;
+		size_t limit;
+
+		//Memory held from the system: arena blocks plus large allocations.
+		size_t reserved;
+
+		//Allocations refused because of the limit.
+		size_t refused;
+	};
+
+	/*
+		Creates a state with its own allocator, already opened with lbind::open.
+
+			StateOptions options;
+			options.memoryLimit = 64 * 1024 * 1024;
+
+			lua_State * state = newstate(options);
+			...
+			closestate(state);
+
+		Allocations of up to 256 bytes, which is most of what Lua allocates, come from per size
+		class free lists backed by an arena, and are only returned to the system when the state is
+		closed. Larger ones go to malloc. Shrinking an allocation never fails, even over the limit.
+
+		States created this way must be closed with closestate.
+	*/
+	lua_State * newstate(const StateOptions& options = StateOptions());
+	void closestate(lua_State * state);
+
+	//Only available for states created with newstate. Others report zeroes.
+	MemoryUsage memoryUsage(lua_State * state);
+	void setMemoryLimit(lua_State * state, size_t limit);
+
+	//Memory held by bound objects that lua owns, as reported by sizeof(T) or the class' size
+	//callback. Works for any state opened with lbind.
+	size_t externalMemory(lua_State * state);
+}
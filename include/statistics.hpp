@@ -0,0 +1,103 @@
+#pragma once
+#include <lua.hpp>
+#include <boost/cstdint.hpp>
+
+#include <string>
+#include <vector>
+
+/*
+	Statistics are only collected when the library is built with LBIND_STATISTICS defined.
+	Without it, none of the counters exist and getStatistics returns zeroes.
+*/
+#ifdef LBIND_STATISTICS
+	#define LBIND_STATISTIC(...) __VA_ARGS__
+#else
+	#define LBIND_STATISTIC(...)
+#endif
+
+namespace lbind
+{
+	//Latencies bucketed by powers of two nanoseconds. Bucket i holds [2^i, 2^(i+1)), bucket 0 also holds 0.
+	struct Histogram
+	{
+		static const size_t buckets = 40;
+
+		Histogram();
+
+		void record(boost::uint64_t nanoseconds);
+		void merge(const Histogram& other);
+
+		//The upper bound of the bucket containing the given fraction of samples, in nanoseconds.
+		boost::uint64_t percentile(double fraction) const;
+
+		boost::uint64_t counts[buckets];
+		boost::uint64_t samples;
+		boost::uint64_t totalNanoseconds;
+	};
+
+	struct FunctionStatistics
+	{
+		FunctionStatistics();
+
+		std::string name;
+		boost::uint64_t calls;
+
+		//Calls where this overload was tried but the arguments did not convert.
+		boost::uint64_t overloadMisses;
+		Histogram latency;
+	};
+
+	struct Statistics
+	{
+		Statistics();
+
+		void merge(const Statistics& other);
+
+		//Values converted across the boundary in either direction, and the bytes of string data among them.
+		boost::uint64_t converts;
+		boost::uint64_t convertedBytes;
+
+		//Calls from Lua into bound functions, and from C++ into Lua.
+		boost::uint64_t luaToC;
+		boost::uint64_t cToLua;
+
+		//Calls where no overload matched the arguments.
+		boost::uint64_t overloadMisses;
+
+		Histogram luaToCLatency;
+		Histogram cToLuaLatency;
+
+		//One entry per bound function name, sorted by total time spent.
+		std::vector<FunctionStatistics> functions;
+	};
+
+	//Passing in null aggregates every state, including ones that were already closed.
+	//Counters are not synchronized, so aggregate while the other states are idle.
+	Statistics getStatistics(lua_State *);
+	void resetStatistics(lua_State *);
+
+	namespace Detail
+	{
+#ifdef LBIND_STATISTICS
+		class InternalState;
+
+		//Live states are aggregated by getStatistics(nullptr), and closed ones fold into a running total.
+		void trackState(InternalState * state);
+		void retireState(InternalState * state);
+
+		//Counts count values starting at first as converted.
+		void countConversions(lua_State * state, int first, int count);
+		boost::uint64_t now();
+
+		//Times a call from C++ into Lua, from construction until destruction.
+		struct LuaCallTimer
+		{
+			LuaCallTimer(lua_State * state, int arguments);
+			~LuaCallTimer();
+
+			lua_State * state;
+			boost::uint64_t start;
+		};
+#endif
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "lua.hpp"
+#include "object.h"
+
+namespace lbind
+{
+	/*
+		Table iteration for Object and StackObject, built directly on lua_next.
+
+		The key and value of the current entry are kept on the stack instead of in the
+		registry, so stepping creates no references and allocates nothing:
+
+			for (auto entry : object)
+			{
+				std::string_view key = entry.key<std::string_view>();
+				double value = entry.value<double>();
+			}
+
+		As with StackObject, the loop body must leave the stack as it found it. The stack is
+		restored to its state before begin() once iteration finishes or the iterator is destroyed,
+		so breaking out of the loop early is fine.
+	*/
+	namespace Detail
+	{
+		//The current key/value pair of an Iterator. Only valid until the iterator advances.
+		class TableEntry
+		{
+		public:
+			TableEntry(lua_State * state, int key);
+
+			template<typename T>
+			T key() const
+			{
+				return indexCast<T>(interpreter, keyIndex);
+			}
+
+			template<typename T>
+			T value() const
+			{
+				return indexCast<T>(interpreter, keyIndex + 1);
+			}
+
+			StackObject key() const;
+			StackObject value() const;
+
+			int keyType() const;
+			int valueType() const;
+		private:
+			lua_State * interpreter;
+			int keyIndex;
+		};
+
+		class Iterator
+		{
+		public:
+			//Starts iterating the table at the given stack index. Everything above base is
+			//popped once iteration ends.
+			Iterator(lua_State * state, int table, int base);
+			Iterator();
+
+			Iterator(Iterator&& other);
+			~Iterator();
+
+			Iterator& operator++();
+			TableEntry operator*() const;
+
+			bool operator==(const Iterator& other) const;
+			bool operator!=(const Iterator& other) const;
+		private:
+			//The key and value cannot be shared between two iterators.
+			Iterator(const Iterator&);
+			Iterator& operator=(const Iterator&);
+
+			void next();
+			void finish();
+
+			lua_State * interpreter;
+			int table;
+			int base;
+			int keyIndex;
+			bool active;
+		};
+	}
+}
@@ -0,0 +1,233 @@
+#pragma once
+#include <lua.hpp>
+#include <boost/optional.hpp>
+
+#include <coroutine>
+#include <exception>
+#include <initializer_list>
+#include <string>
+#include <utility>
+
+#include "async.hpp"
+#include "luafunction.hpp"
+#include "object.h"
+
+namespace lbind
+{
+	namespace Detail
+	{
+		//A Lua function in a coroutine of an EventLoop, resumed when a C++ coroutine awaits it.
+		class LuaCoroutine : public CoroutineObserver
+		{
+		public:
+			LuaCoroutine(const LuaCoroutine&) = delete;
+			LuaCoroutine& operator=(const LuaCoroutine&) = delete;
+		protected:
+			//Generators are told each value the function yields. Otherwise yields are left to the
+			//loop, and only the return value is taken.
+			template<typename... Args>
+			LuaCoroutine(bool generator, EventLoop& loop, const Object& function, Args&&... args)
+				:done(false)
+				,loop(loop)
+				,state(function.state())
+				,thread(loop.create(function, this))
+				,arguments(sizeof...(Args))
+				,generator(generator)
+				,started(false)
+				,running(false)
+			{
+				(void)std::initializer_list<int>{0, (Convert<typename Undecorate<Args>::type>::to(thread, args), 0)...};
+			}
+
+			~LuaCoroutine();
+
+			//Runs the function until it yields a value, returns or raises an error. Returns false
+			//if it did so before this returned, and awaiting should carry on. Otherwise awaiting
+			//is resumed once it does, by the loop.
+			bool resume(std::coroutine_handle<> awaiting);
+
+			//Throws the error the function raised, or the BadCast a value it gave failed with, if
+			//either happened since the last call.
+			void rethrow();
+
+			//Converts the first of results values on top of the thread, or nil if there are none.
+			template<typename T>
+			T first(lua_State * from, int results) const
+			{
+				if (results)
+				{
+					lua_pushvalue(from, -results);
+				}
+				else
+				{
+					lua_pushnil(from);
+				}
+
+				//Converted on the state, since the thread is released once it finishes. Throws
+				//BadCast if the value does not convert to T.
+				lua_xmove(from, state, 1);
+				return LuaResult<T>::pop(state);
+			}
+
+			//Takes a value the function yielded or returned.
+			virtual void take(lua_State * from, int results) = 0;
+
+			bool done;
+		private:
+			bool yielded(lua_State * from, int results);
+			void finished(lua_State * from, int results, const std::string * error);
+
+			void wake();
+
+			EventLoop& loop;
+			lua_State * state;
+			lua_State * thread;
+			int arguments;
+			bool generator;
+
+			bool started;
+			bool running;
+			std::exception_ptr error;
+
+			std::coroutine_handle<> awaiting;
+		};
+	}
+
+	/*
+		Awaits a Lua function run in a coroutine of an EventLoop, from a C++ coroutine.
+
+			Task<std::string> handled(loop, globals(state)["handle"], request);
+			std::string response = co_await handled;
+
+		The function starts when the task is awaited, and may suspend on Asyncs or yield as often as
+		it likes; the awaiting coroutine is resumed by the loop with what it returns, or LuaError if
+		it raises one, or BadCast if what it returns does not convert to R. A function that finishes
+		without suspending does not suspend the awaiting coroutine either. Values it yields are
+		ignored.
+
+		Neither a task nor the loop can be moved or destroyed while awaited. A task destroyed before
+		its function finishes leaves the function to the loop.
+	*/
+	template<typename R>
+	class Task : private Detail::LuaCoroutine
+	{
+	public:
+		template<typename... Args>
+		Task(EventLoop& loop, const Object& function, Args&&... args)
+			:LuaCoroutine(false, loop, function, std::forward<Args>(args)...)
+		{}
+
+		bool await_ready() const
+		{
+			return false;
+		}
+
+		bool await_suspend(std::coroutine_handle<> awaiting)
+		{
+			return resume(awaiting);
+		}
+
+		R await_resume()
+		{
+			rethrow();
+			return std::move(*result);
+		}
+	private:
+		void take(lua_State * from, int results)
+		{
+			result = first<R>(from, results);
+		}
+
+		boost::optional<R> result;
+	};
+
+	template<>
+	class Task<void> : private Detail::LuaCoroutine
+	{
+	public:
+		template<typename... Args>
+		Task(EventLoop& loop, const Object& function, Args&&... args)
+			:LuaCoroutine(false, loop, function, std::forward<Args>(args)...)
+		{}
+
+		bool await_ready() const
+		{
+			return false;
+		}
+
+		bool await_suspend(std::coroutine_handle<> awaiting)
+		{
+			return resume(awaiting);
+		}
+
+		void await_resume()
+		{
+			rethrow();
+		}
+	private:
+		void take(lua_State *, int)
+		{}
+	};
+
+	/*
+		The values a Lua function yields, one at a time, to a C++ coroutine.
+
+			Generator<int> counted(loop, globals(state)["count"], 10);
+			while (boost::optional<int> n = co_await counted.next())
+			{
+				...
+			}
+
+		The function runs until it yields the next value each time next is awaited, and next gives
+		none once it returns, or throws LuaError if it raises one. A value that does not convert to
+		T is thrown as BadCast instead, and the next one can still be awaited. Between values, the
+		function can suspend on Asyncs as Tasks do.
+
+		A generator destroyed between values closes the function where it yielded.
+	*/
+	template<typename T>
+	class Generator : private Detail::LuaCoroutine
+	{
+	public:
+		struct Next
+		{
+			bool await_ready() const
+			{
+				return generator.done;
+			}
+
+			bool await_suspend(std::coroutine_handle<> awaiting)
+			{
+				return generator.resume(awaiting);
+			}
+
+			boost::optional<T> await_resume()
+			{
+				generator.rethrow();
+
+				boost::optional<T> out = std::move(generator.value);
+				generator.value = boost::none;
+				return out;
+			}
+
+			Generator& generator;
+		};
+
+		template<typename... Args>
+		Generator(EventLoop& loop, const Object& function, Args&&... args)
+			:LuaCoroutine(true, loop, function, std::forward<Args>(args)...)
+		{}
+
+		Next next()
+		{
+			return Next{ *this };
+		}
+	private:
+		void take(lua_State * from, int results)
+		{
+			value = first<T>(from, results);
+		}
+
+		boost::optional<T> value;
+	};
+}
@@ -1,9 +1,17 @@
 #pragma once
 #include <boost/fusion/include/at_c.hpp>
 #include <boost/preprocessor/iteration/local.hpp>
+#include <boost/preprocessor/arithmetic/sub.hpp>
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/punctuation/comma_if.hpp>
+#include <boost/preprocessor/repetition/enum_params.hpp>
+#include <boost/preprocessor/repetition/repeat.hpp>
+#include <boost/preprocessor/repetition/repeat_from_to.hpp>
 #include <boost/optional.hpp>
 #include "traits.hpp"
 #include "convert.hpp"
+#include "statistics.hpp"
+#include "recorder.hpp"
 
 #include <iostream>
 
@@ -92,6 +100,8 @@ namespace lbind
 
 			(void)std::initializer_list<int>{(lbind::Convert<typename Undecorate<Args>::type>::to(o.state(), a), 1)...};
 
+			Detail::RecordedLuaCall recorded(o.state(), sizeof...(Args), 0);
+			LBIND_STATISTIC(Detail::LuaCallTimer timer(o.state(), sizeof...(Args)));
 			Detail::pcallWrapper(o.state(), sizeof...(Args), 1, 0);
 		}
 	};
@@ -107,9 +117,12 @@ namespace lbind
 
 			(void)std::initializer_list<int>{(lbind::Convert<typename Undecorate<Args>::type>::to(o.state(), a), 1)...};
 
+			Detail::RecordedLuaCall recorded(o.state(), sizeof...(Args), 1);
+			LBIND_STATISTIC(Detail::LuaCallTimer timer(o.state(), sizeof...(Args)));
 			Detail::pcallWrapper(o.state(), sizeof...(Args), 1, 0);
 			R res;
 			Convert<R>::from(o.state(), -1, res);
+			LBIND_STATISTIC(Detail::countConversions(o.state(), -1, 1));
 			return res;
 		}
 	};
@@ -0,0 +1,76 @@
+#include "arena.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace lbind
+{
+	namespace Detail
+	{
+		Arena::Arena(size_t blockSize)
+			:blockSize(blockSize)
+			,current(nullptr)
+			,remaining(0)
+			,reservedBytes(0)
+		{}
+
+		Arena::~Arena()
+		{
+			release();
+		}
+
+		void * Arena::allocate(size_t bytes, size_t alignment)
+		{
+			size_t padding = (alignment - reinterpret_cast<std::uintptr_t>(current) % alignment) % alignment;
+			if (!current || padding + bytes > remaining)
+			{
+				//Oversized requests get a block of their own, which the current block outlives.
+				size_t size = bytes + alignment > blockSize ? bytes + alignment : blockSize;
+
+				char * block = static_cast<char *>(std::malloc(size));
+				if (!block)
+				{
+					throw std::bad_alloc();
+				}
+
+				blocks.push_back(block);
+				reservedBytes += size;
+
+				if (size != blockSize)
+				{
+					size_t offset = (alignment - reinterpret_cast<std::uintptr_t>(block) % alignment) % alignment;
+					return block + offset;
+				}
+
+				current = block;
+				remaining = size;
+				padding = (alignment - reinterpret_cast<std::uintptr_t>(current) % alignment) % alignment;
+			}
+
+			char * result = current + padding;
+			current += padding + bytes;
+			remaining -= padding + bytes;
+
+			return result;
+		}
+
+		void Arena::release()
+		{
+			for (char * block : blocks)
+			{
+				std::free(block);
+			}
+
+			blocks.clear();
+			current = nullptr;
+			remaining = 0;
+			reservedBytes = 0;
+		}
+
+		size_t Arena::reserved() const
+		{
+			return reservedBytes;
+		}
+	}
+}
@@ -0,0 +1,445 @@
+#include "async.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace lbind
+{
+	namespace
+	{
+		const size_t wheelSlots = 256;
+
+		//Runs when a coroutine suspended in FunctionBase::apply is resumed, with what
+		//EventLoop::complete passed: whether the Async succeeded, then its value or error.
+		int resumed(lua_State * l, int, lua_KContext results)
+		{
+			if (!lua_toboolean(l, -2))
+			{
+				return lua_error(l);
+			}
+
+			return static_cast<int>(results);
+		}
+	}
+
+	namespace Detail
+	{
+		AsyncBase::AsyncBase()
+			:done(false)
+			,failed(false)
+			,loop(nullptr)
+			,thread(nullptr)
+		{}
+
+		AsyncBase::~AsyncBase()
+		{}
+
+		bool AsyncBase::ready() const
+		{
+			std::lock_guard<std::mutex> held(lock);
+			return done;
+		}
+
+		void AsyncBase::fail(const std::string& message)
+		{
+			std::unique_lock<std::mutex> held(lock);
+			if (!done)
+			{
+				failed = true;
+				error = message;
+				finish(held);
+			}
+		}
+
+		void AsyncBase::finish(std::unique_lock<std::mutex>&)
+		{
+			done = true;
+
+			//Posted while the lock is held, so the loop can not detach in between.
+			if (loop)
+			{
+				EventLoop * target = loop;
+				lua_State * waiting = thread;
+				target->post([target, waiting]() {
+					target->complete(waiting);
+				});
+
+				loop = nullptr;
+				thread = nullptr;
+			}
+		}
+
+		int awaitAsync(lua_State * state, std::shared_ptr<AsyncBase> pending)
+		{
+			{
+				std::lock_guard<std::mutex> held(pending->lock);
+				if (pending->done && !pending->failed)
+				{
+					pending->push(state);
+					return pending->results();
+				}
+			}
+
+			//Only the result of a bound function can suspend, once. Anything else, like an Async
+			//passed as an argument to a Lua function, would suspend whichever binding runs next.
+			InternalState * internal = getInternalState(state);
+			if (!internal->bindingDepth || internal->suspending)
+			{
+				throw BadCast("A pending Async can only be returned from a bound function");
+			}
+
+			internal->suspending = std::move(pending);
+			return 0;
+		}
+
+		int suspend(lua_State * state, InternalState * internal)
+		{
+			int results;
+
+			//Neither lua_error nor lua_yieldk unwind, so nothing with a destructor can be alive
+			//when they are called.
+			{
+				std::shared_ptr<AsyncBase> pending = std::move(internal->suspending);
+				internal->suspending.reset();
+				results = pending->results();
+
+				if (!lua_isyieldable(state))
+				{
+					lua_pushstring(state, "An Async can only be waited on from a coroutine");
+					results = -1;
+				}
+				else if (!internal->eventLoop || !internal->eventLoop->wait(state, std::move(pending)))
+				{
+					lua_pushstring(state, "An Async can only be waited on from a coroutine started by EventLoop::spawn");
+					results = -1;
+				}
+			}
+
+			if (results < 0)
+			{
+				return lua_error(state);
+			}
+
+			return lua_yieldk(state, 0, results, &resumed);
+		}
+	}
+
+	EventLoop::EventLoop(lua_State * state, std::chrono::microseconds tick)
+		:state(state)
+		,pool(state)
+		,tick(std::max(tick, std::chrono::microseconds(1)))
+		,start(std::chrono::steady_clock::now())
+		,currentTick(0)
+		,wheel(wheelSlots)
+		,timers(0)
+	{
+		Detail::InternalState * internal = Detail::getInternalState(state);
+		if (internal->eventLoop)
+		{
+			throw BindingError("An EventLoop is already running this state");
+		}
+
+		internal->eventLoop = this;
+	}
+
+	EventLoop::~EventLoop()
+	{
+		for (auto& t : threads)
+		{
+			//Completing the Async later does nothing.
+			if (t.second.waiting)
+			{
+				std::lock_guard<std::mutex> held(t.second.waiting->lock);
+				t.second.waiting->loop = nullptr;
+				t.second.waiting->thread = nullptr;
+			}
+		}
+
+		//Gone if lbind::close ran first.
+		Detail::InternalState * internal = Detail::getInternalState(state);
+		if (internal)
+		{
+			internal->eventLoop = nullptr;
+		}
+	}
+
+	void EventLoop::post(std::function<void()> f)
+	{
+		{
+			std::lock_guard<std::mutex> held(lock);
+			posted.push_back(std::move(f));
+		}
+
+		wake.notify_one();
+	}
+
+	void EventLoop::after(std::chrono::microseconds delay, std::function<void()> f)
+	{
+		boost::uint64_t ticks = static_cast<boost::uint64_t>((std::max(delay.count(), static_cast<std::chrono::microseconds::rep>(0)) + tick.count() - 1) / tick.count());
+		boost::uint64_t deadline = std::max(currentTick, elapsedTicks()) + std::max(ticks, static_cast<boost::uint64_t>(1));
+
+		wheel[deadline % wheel.size()].push_back(Timer{ deadline, std::move(f) });
+		timers++;
+	}
+
+	void EventLoop::run()
+	{
+		for (;;)
+		{
+			poll();
+
+			std::unique_lock<std::mutex> held(lock);
+			if (!posted.empty())
+			{
+				continue;
+			}
+
+			if (timers)
+			{
+				std::chrono::steady_clock::time_point next = start + tick * (currentTick + 1);
+				wake.wait_until(held, next, [this]() { return !posted.empty(); });
+			}
+			else if (!threads.empty())
+			{
+				wake.wait(held, [this]() { return !posted.empty(); });
+			}
+			else
+			{
+				return;
+			}
+		}
+	}
+
+	size_t EventLoop::poll()
+	{
+		{
+			std::lock_guard<std::mutex> held(lock);
+			running.swap(posted);
+		}
+
+		size_t i = 0;
+		try
+		{
+			for (; i < running.size(); ++i)
+			{
+				running[i]();
+			}
+		}
+		catch (...)
+		{
+			//What has not run yet runs on the next turn.
+			{
+				std::lock_guard<std::mutex> held(lock);
+				posted.insert(posted.begin(), std::make_move_iterator(running.begin() + i + 1), std::make_move_iterator(running.end()));
+			}
+
+			running.clear();
+			throw;
+		}
+
+		running.clear();
+		return i + fireTimers();
+	}
+
+	size_t EventLoop::coroutines() const
+	{
+		return threads.size();
+	}
+
+	lua_State * EventLoop::create(const Object& function, Detail::CoroutineObserver * observer)
+	{
+		PooledCoroutine pooled = pool.acquire();
+		lua_State * thread = pooled.get();
+
+		threads.emplace(thread, Coroutine{ std::move(pooled), nullptr, observer });
+		Convert<Object>::to(thread, function);
+		return thread;
+	}
+
+	void EventLoop::resume(lua_State * thread, int arguments)
+	{
+		int results = 0;
+		int status = lua_resume(thread, state, arguments, &results);
+
+		Coroutine& coroutine = threads[thread];
+		if (status == LUA_YIELD)
+		{
+			//Yielded by coroutine.yield rather than on an Async, so it goes again next turn,
+			//unless its observer takes it from here.
+			bool handled = coroutine.waiting != nullptr;
+			if (!handled && coroutine.observer)
+			{
+				try
+				{
+					handled = coroutine.observer->yielded(thread, results);
+				}
+				catch (...)
+				{
+					threads.erase(thread);
+					throw;
+				}
+			}
+
+			lua_pop(thread, results);
+
+			if (!handled)
+			{
+				post([this, thread]() {
+					resume(thread, 0);
+				});
+			}
+
+			return;
+		}
+
+		Detail::CoroutineObserver * observer = coroutine.observer;
+
+		std::string error;
+		if (status != LUA_OK)
+		{
+			const char * message = lua_tostring(thread, -1);
+			error = message ? message : "(error object is not a string)";
+		}
+
+		if (observer)
+		{
+			try
+			{
+				observer->finished(thread, status == LUA_OK ? results : 0, status == LUA_OK ? nullptr : &error);
+			}
+			catch (...)
+			{
+				threads.erase(thread);
+				throw;
+			}
+		}
+
+		//The pool closes it if it raised an error.
+		threads.erase(thread);
+
+		if (status != LUA_OK && !observer)
+		{
+			throw LuaError(error.c_str());
+		}
+	}
+
+	void EventLoop::detach(lua_State * thread, Detail::CoroutineObserver * observer)
+	{
+		auto found = threads.find(thread);
+		if (found != threads.end() && found->second.observer == observer)
+		{
+			found->second.observer = nullptr;
+		}
+	}
+
+	void EventLoop::release(lua_State * thread, Detail::CoroutineObserver * observer)
+	{
+		auto found = threads.find(thread);
+		if (found != threads.end() && found->second.observer == observer)
+		{
+			threads.erase(found);
+		}
+	}
+
+	void EventLoop::complete(lua_State * thread)
+	{
+		auto found = threads.find(thread);
+		if (found == threads.end() || !found->second.waiting)
+		{
+			return;
+		}
+
+		//Nothing changes an Async once it is done, and posting it here ordered the writes.
+		std::shared_ptr<Detail::AsyncBase> completed = std::move(found->second.waiting);
+		found->second.waiting.reset();
+
+		lua_pushboolean(thread, !completed->failed);
+		if (completed->failed)
+		{
+			lua_pushlstring(thread, completed->error.data(), completed->error.size());
+		}
+		else if (completed->results())
+		{
+			completed->push(thread);
+		}
+		else
+		{
+			lua_pushnil(thread);
+		}
+
+		completed.reset();
+		resume(thread, 2);
+	}
+
+	bool EventLoop::wait(lua_State * thread, std::shared_ptr<Detail::AsyncBase> pending)
+	{
+		auto found = threads.find(thread);
+		if (found == threads.end())
+		{
+			return false;
+		}
+
+		found->second.waiting = pending;
+
+		std::lock_guard<std::mutex> held(pending->lock);
+		if (pending->done)
+		{
+			post([this, thread]() {
+				complete(thread);
+			});
+		}
+		else
+		{
+			pending->loop = this;
+			pending->thread = thread;
+		}
+
+		return true;
+	}
+
+	boost::uint64_t EventLoop::elapsedTicks() const
+	{
+		return static_cast<boost::uint64_t>((std::chrono::steady_clock::now() - start) / tick);
+	}
+
+	size_t EventLoop::fireTimers()
+	{
+		boost::uint64_t now = elapsedTicks();
+		if (!timers)
+		{
+			currentTick = std::max(currentTick, now);
+			return 0;
+		}
+
+		size_t fired = 0;
+		while (currentTick < now && timers)
+		{
+			//The tick only counts as passed once its slot is empty of due timers, so a timer that
+			//throws leaves the rest of its slot to the next call.
+			boost::uint64_t next = currentTick + 1;
+			std::vector<Timer>& slot = wheel[next % wheel.size()];
+
+			for (size_t i = 0; i < slot.size();)
+			{
+				if (slot[i].deadline > next)
+				{
+					++i;
+					continue;
+				}
+
+				std::function<void()> f = std::move(slot[i].f);
+				slot[i] = std::move(slot.back());
+				slot.pop_back();
+				timers--;
+				fired++;
+
+				f();
+			}
+
+			currentTick = next;
+		}
+
+		currentTick = std::max(currentTick, now);
+		return fired;
+	}
+}
@@ -0,0 +1,337 @@
+#include "bundle.hpp"
+#include "chunkcache.hpp"
+#include "exceptions.hpp"
+#include "stackcheck.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lbind
+{
+	namespace
+	{
+		const char bundleMagic[4] = { 'L', 'B', 'B', '1' };
+
+		//Hands the whole chunk to lua_load in one piece, straight from the mapping.
+		struct ChunkReader
+		{
+			const char * data;
+			size_t size;
+		};
+
+		const char * readChunk(lua_State *, void * ud, size_t * size)
+		{
+			ChunkReader * reader = static_cast<ChunkReader *>(ud);
+			*size = reader->size;
+			reader->size = 0;
+
+			return *size ? reader->data : nullptr;
+		}
+	}
+
+	Bundle::Bundle(const std::string& path)
+		:data(nullptr)
+		,length(0)
+		,entries(nullptr)
+		,count(0)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			throw BindingError(("Cannot open bundle " + path).c_str());
+		}
+
+		struct stat info;
+		if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Detail::BundleHeader)))
+		{
+			::close(fd);
+			throw BindingError(("Not a bundle: " + path).c_str());
+		}
+
+		length = static_cast<size_t>(info.st_size);
+		void * mapped = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+
+		if (mapped == MAP_FAILED)
+		{
+			throw BindingError(("Cannot map bundle " + path).c_str());
+		}
+
+		data = static_cast<const char *>(mapped);
+
+		const Detail::BundleHeader * header = reinterpret_cast<const Detail::BundleHeader *>(data);
+		bool valid = std::memcmp(header->magic, bundleMagic, sizeof(bundleMagic)) == 0 &&
+			header->version == LUA_VERSION_NUM &&
+			header->count <= (length - sizeof(Detail::BundleHeader)) / sizeof(Detail::BundleEntry);
+
+		if (valid)
+		{
+			entries = reinterpret_cast<const Detail::BundleEntry *>(data + sizeof(Detail::BundleHeader));
+			count = static_cast<size_t>(header->count);
+
+			for (size_t i = 0; i < count && valid; ++i)
+			{
+				//Written so that a corrupt offset can not overflow past the check.
+				valid = entries[i].nameOffset <= length && entries[i].nameLength <= length - entries[i].nameOffset &&
+					entries[i].offset <= length && entries[i].size <= length - entries[i].offset;
+			}
+		}
+
+		if (!valid)
+		{
+			::munmap(const_cast<char *>(data), length);
+			throw BindingError(("Not a bundle for this Lua version: " + path).c_str());
+		}
+	}
+
+	Bundle::~Bundle()
+	{
+		::munmap(const_cast<char *>(data), length);
+	}
+
+	size_t Bundle::size() const
+	{
+		return count;
+	}
+
+	bool Bundle::contains(boost::string_ref name) const
+	{
+		return find(name) != nullptr;
+	}
+
+	std::vector<std::string> Bundle::names() const
+	{
+		std::vector<std::string> result;
+		result.reserve(count);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			result.push_back(nameOf(entries[i]).to_string());
+		}
+
+		return result;
+	}
+
+	Object Bundle::load(lua_State * state, boost::string_ref name) const
+	{
+		StackCheck check(state, 0, 0);
+
+		const Detail::BundleEntry * entry = find(name);
+		if (!entry)
+		{
+			std::string message = "No chunk named " + name.to_string() + " in bundle";
+			throw LuaError(message.c_str());
+		}
+
+		if (loadEntry(state, *entry) != LUA_OK)
+		{
+			std::string message = lua_tostring(state, -1);
+			lua_pop(state, 1);
+			throw LuaError(message.c_str());
+		}
+
+		Object result = Object::fromStack(state, -1);
+		lua_pop(state, 1);
+		return result;
+	}
+
+	void Bundle::install(lua_State * state) const
+	{
+		StackCheck check(state, 0, 0);
+
+		lua_getglobal(state, "package");
+		if (lua_getfield(state, -1, "searchers") != LUA_TTABLE)
+		{
+			lua_pop(state, 2);
+			throw BindingError("Bundle::install requires the package library");
+		}
+
+		//Shift everything after the preload searcher up by one.
+		lua_Integer n = static_cast<lua_Integer>(lua_rawlen(state, -1));
+		for (lua_Integer i = n; i >= 2; --i)
+		{
+			lua_rawgeti(state, -1, i);
+			lua_rawseti(state, -2, i + 1);
+		}
+
+		lua_pushlightuserdata(state, const_cast<Bundle *>(this));
+		lua_pushcclosure(state, &Bundle::searcher, 1);
+		lua_rawseti(state, -2, 2);
+
+		lua_pop(state, 2);
+	}
+
+	int Bundle::searcher(lua_State * state)
+	{
+		const Bundle * self = static_cast<const Bundle *>(lua_touserdata(state, lua_upvalueindex(1)));
+
+		size_t size = 0;
+		const char * name = luaL_checklstring(state, 1, &size);
+
+		const Detail::BundleEntry * entry = self->find(boost::string_ref(name, size));
+		if (!entry)
+		{
+			lua_pushfstring(state, "no module '%s' in bundle", name);
+			return 1;
+		}
+
+		if (self->loadEntry(state, *entry) != LUA_OK)
+		{
+			return luaL_error(state, "error loading module '%s' from bundle:\n\t%s", name, lua_tostring(state, -1));
+		}
+
+		//The second value is passed to the loader, like the file name for file searchers.
+		lua_pushfstring(state, ":bundle:%s", name);
+		return 2;
+	}
+
+	const Detail::BundleEntry * Bundle::find(boost::string_ref name) const
+	{
+		const Detail::BundleEntry * end = entries + count;
+		const Detail::BundleEntry * it = std::lower_bound(entries, end, name, [this](const Detail::BundleEntry& e, boost::string_ref n)
+		{
+			return nameOf(e) < n;
+		});
+
+		if (it != end && nameOf(*it) == name)
+		{
+			return it;
+		}
+
+		return nullptr;
+	}
+
+	boost::string_ref Bundle::nameOf(const Detail::BundleEntry& entry) const
+	{
+		return boost::string_ref(data + entry.nameOffset, static_cast<size_t>(entry.nameLength));
+	}
+
+	int Bundle::loadEntry(lua_State * state, const Detail::BundleEntry& entry) const
+	{
+		std::string chunkname = "@" + nameOf(entry).to_string();
+
+		ChunkReader reader = { data + entry.offset, static_cast<size_t>(entry.size) };
+		return lua_load(state, readChunk, &reader, chunkname.c_str(), "b");
+	}
+
+	BundleWriter::BundleWriter()
+		:stripDebug(false)
+	{}
+
+	void BundleWriter::add(boost::string_ref name, boost::string_ref source)
+	{
+		lua_State * state = luaL_newstate();
+		if (!state)
+		{
+			throw std::bad_alloc();
+		}
+
+		std::string chunkname = "@" + name.to_string();
+		if (luaL_loadbufferx(state, source.data(), source.size(), chunkname.c_str(), "t") != LUA_OK)
+		{
+			std::string message = lua_tostring(state, -1);
+			lua_close(state);
+			throw LuaError(message.c_str());
+		}
+
+		std::string bytecode;
+		Detail::dumpFunction(state, -1, bytecode, stripDebug);
+		lua_close(state);
+
+		addBytecode(name, std::move(bytecode));
+	}
+
+	void BundleWriter::addBytecode(boost::string_ref name, std::string bytecode)
+	{
+		for (Chunk& c : chunks)
+		{
+			if (c.name == name)
+			{
+				c.bytecode = std::move(bytecode);
+				return;
+			}
+		}
+
+		chunks.push_back(Chunk{ name.to_string(), std::move(bytecode) });
+	}
+
+	void BundleWriter::strip(bool s)
+	{
+		stripDebug = s;
+	}
+
+	void BundleWriter::write(const std::string& path) const
+	{
+		std::vector<const Chunk *> sorted;
+		for (const Chunk& c : chunks)
+		{
+			sorted.push_back(&c);
+		}
+
+		std::sort(sorted.begin(), sorted.end(), [](const Chunk * a, const Chunk * b)
+		{
+			return a->name < b->name;
+		});
+
+		Detail::BundleHeader header;
+		std::memcpy(header.magic, bundleMagic, sizeof(bundleMagic));
+		header.version = LUA_VERSION_NUM;
+		header.count = sorted.size();
+
+		//Layout: header, index, names, then the chunks.
+		std::vector<Detail::BundleEntry> index(sorted.size());
+		boost::uint64_t offset = sizeof(header) + sizeof(Detail::BundleEntry) * index.size();
+
+		for (size_t i = 0; i < sorted.size(); ++i)
+		{
+			index[i].nameOffset = offset;
+			index[i].nameLength = sorted[i]->name.size();
+			offset += sorted[i]->name.size();
+		}
+
+		for (size_t i = 0; i < sorted.size(); ++i)
+		{
+			index[i].offset = offset;
+			index[i].size = sorted[i]->bytecode.size();
+			offset += sorted[i]->bytecode.size();
+		}
+
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char *>(index.data()), sizeof(Detail::BundleEntry) * index.size());
+
+			for (const Chunk * c : sorted)
+			{
+				file.write(c->name.data(), c->name.size());
+			}
+
+			for (const Chunk * c : sorted)
+			{
+				file.write(c->bytecode.data(), c->bytecode.size());
+			}
+
+			if (!file)
+			{
+				file.close();
+				std::remove(temporary.c_str());
+				throw BindingError(("Cannot write bundle " + path).c_str());
+			}
+		}
+
+		if (std::rename(temporary.c_str(), path.c_str()) != 0)
+		{
+			std::remove(temporary.c_str());
+			throw BindingError(("Cannot write bundle " + path).c_str());
+		}
+	}
+}
@@ -0,0 +1,294 @@
+#include "chunkcache.hpp"
+#include "exceptions.hpp"
+#include "stackcheck.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace lbind
+{
+	namespace Detail
+	{
+		boost::uint64_t hashChunk(boost::string_ref source, boost::string_ref name)
+		{
+			boost::uint64_t hash = 14695981039346656037ULL;
+			auto mix = [&hash](boost::string_ref data)
+			{
+				for (char c : data)
+				{
+					hash ^= static_cast<unsigned char>(c);
+					hash *= 1099511628211ULL;
+				}
+			};
+
+			mix(name);
+
+			//Separate the name from the source, so "ab" + "c" and "a" + "bc" differ.
+			hash ^= 0xff;
+			hash *= 1099511628211ULL;
+
+			mix(source);
+			return hash;
+		}
+
+		namespace
+		{
+			int appendBytecode(lua_State *, const void * p, size_t size, void * ud)
+			{
+				static_cast<std::string *>(ud)->append(static_cast<const char *>(p), size);
+				return 0;
+			}
+
+			//Precedes the bytecode in every cache file.
+			struct FileHeader
+			{
+				char magic[4];
+				boost::uint32_t version;
+				boost::uint64_t hash;
+				boost::uint64_t sourceSize;
+			};
+
+			const char fileMagic[4] = { 'L', 'B', 'C', '1' };
+		}
+
+		void dumpFunction(lua_State * state, int index, std::string& out, bool strip)
+		{
+			lua_pushvalue(state, index);
+			lua_dump(state, appendBytecode, &out, strip ? 1 : 0);
+			lua_pop(state, 1);
+		}
+	}
+
+	ChunkCache::ChunkCache()
+		:stateHits(0)
+		,memoryHits(0)
+		,diskHits(0)
+		,compiles(0)
+	{}
+
+	ChunkCache::ChunkCache(const std::string& directory)
+		:cacheDirectory(directory)
+		,stateHits(0)
+		,memoryHits(0)
+		,diskHits(0)
+		,compiles(0)
+	{
+		std::error_code ignored;
+		std::filesystem::create_directories(cacheDirectory, ignored);
+	}
+
+	Object ChunkCache::load(lua_State * state, boost::string_ref source, boost::string_ref name)
+	{
+		StackCheck check(state, 0, 0);
+		boost::uint64_t hash = Detail::hashChunk(source, name);
+
+		//Functions loaded into this state live in a registry table owned by this cache.
+		if (lua_rawgetp(state, LUA_REGISTRYINDEX, this) != LUA_TTABLE)
+		{
+			lua_pop(state, 1);
+			lua_newtable(state);
+			lua_pushvalue(state, -1);
+			lua_rawsetp(state, LUA_REGISTRYINDEX, this);
+		}
+
+		int loaded = lua_gettop(state);
+		lua_Integer key = static_cast<lua_Integer>(hash);
+
+		if (lua_rawgeti(state, loaded, key) == LUA_TFUNCTION)
+		{
+			stateHits++;
+
+			Object result = Object::fromStack(state, -1);
+			lua_pop(state, 2);
+			return result;
+		}
+
+		lua_pop(state, 1);
+
+		if (!loadBytecode(state, hash, source.size(), name))
+		{
+			//lua_load wants a null terminated name.
+			std::string chunkname(name.data(), name.size());
+			if (luaL_loadbufferx(state, source.data(), source.size(), chunkname.c_str(), "t") != LUA_OK)
+			{
+				std::string message = lua_tostring(state, -1);
+				lua_pop(state, 2);
+				throw LuaError(message.c_str());
+			}
+
+			compiles++;
+
+			std::string dumped;
+			Detail::dumpFunction(state, -1, dumped);
+
+			if (!cacheDirectory.empty())
+			{
+				writeFile(hash, source.size(), dumped);
+			}
+
+			std::shared_ptr<const std::string> shared = std::make_shared<const std::string>(std::move(dumped));
+
+			std::lock_guard<std::mutex> guard(lock);
+			bytecode[hash] = std::move(shared);
+		}
+
+		lua_pushvalue(state, -1);
+		lua_rawseti(state, loaded, key);
+
+		Object result = Object::fromStack(state, -1);
+		lua_pop(state, 2);
+		return result;
+	}
+
+	//Pushes the function on success.
+	bool ChunkCache::loadBytecode(lua_State * state, boost::uint64_t hash, size_t sourceSize, boost::string_ref name)
+	{
+		std::string chunkname(name.data(), name.size());
+
+		std::shared_ptr<const std::string> cached;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			auto it = bytecode.find(hash);
+			if (it != bytecode.end())
+			{
+				cached = it->second;
+			}
+		}
+
+		if (cached)
+		{
+			if (luaL_loadbufferx(state, cached->data(), cached->size(), chunkname.c_str(), "b") == LUA_OK)
+			{
+				memoryHits++;
+				return true;
+			}
+
+			lua_pop(state, 1);
+
+			//Unless another thread already replaced it.
+			std::lock_guard<std::mutex> guard(lock);
+			auto it = bytecode.find(hash);
+			if (it != bytecode.end() && it->second == cached)
+			{
+				bytecode.erase(it);
+			}
+		}
+
+		std::string stored;
+		if (cacheDirectory.empty() || !readFile(hash, sourceSize, stored))
+		{
+			return false;
+		}
+
+		if (luaL_loadbufferx(state, stored.data(), stored.size(), chunkname.c_str(), "b") != LUA_OK)
+		{
+			//Corrupt, most likely. It gets recompiled and rewritten.
+			lua_pop(state, 1);
+			return false;
+		}
+
+		diskHits++;
+
+		std::shared_ptr<const std::string> shared = std::make_shared<const std::string>(std::move(stored));
+
+		std::lock_guard<std::mutex> guard(lock);
+		bytecode[hash] = std::move(shared);
+		return true;
+	}
+
+	bool ChunkCache::readFile(boost::uint64_t hash, size_t sourceSize, std::string& out) const
+	{
+		std::ifstream file(path(hash), std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		Detail::FileHeader header;
+		if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+		{
+			return false;
+		}
+
+		if (std::memcmp(header.magic, Detail::fileMagic, sizeof(header.magic)) != 0 ||
+			header.version != LUA_VERSION_NUM ||
+			header.hash != hash ||
+			header.sourceSize != sourceSize)
+		{
+			return false;
+		}
+
+		out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return !out.empty();
+	}
+
+	void ChunkCache::writeFile(boost::uint64_t hash, size_t sourceSize, const std::string& bytecode) const
+	{
+		Detail::FileHeader header;
+		std::memcpy(header.magic, Detail::fileMagic, sizeof(header.magic));
+		header.version = LUA_VERSION_NUM;
+		header.hash = hash;
+		header.sourceSize = sourceSize;
+
+		//Write to a temporary file and rename it into place, so other processes never see a partial file.
+		std::string target = path(hash);
+		boost::uint64_t salt = reinterpret_cast<boost::uintptr_t>(this) ^ std::chrono::steady_clock::now().time_since_epoch().count();
+		std::string temporary = target + ".tmp" + std::to_string(salt);
+
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file)
+			{
+				return;
+			}
+
+			file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			file.write(bytecode.data(), bytecode.size());
+
+			if (!file)
+			{
+				file.close();
+				std::remove(temporary.c_str());
+				return;
+			}
+		}
+
+		if (std::rename(temporary.c_str(), target.c_str()) != 0)
+		{
+			std::remove(temporary.c_str());
+		}
+	}
+
+	std::string ChunkCache::path(boost::uint64_t hash) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.luac", static_cast<unsigned long long>(hash));
+
+		return (std::filesystem::path(cacheDirectory) / name).string();
+	}
+
+	void ChunkCache::clear()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		bytecode.clear();
+	}
+
+	ChunkCache::Counters ChunkCache::counters() const
+	{
+		Counters result;
+		result.stateHits = stateHits;
+		result.memoryHits = memoryHits;
+		result.diskHits = diskHits;
+		result.compiles = compiles;
+
+		return result;
+	}
+
+	const std::string& ChunkCache::directory() const
+	{
+		return cacheDirectory;
+	}
+}
@@ -0,0 +1,118 @@
+#include "compiler.hpp"
+#include "chunkcache.hpp"
+#include "stackcheck.hpp"
+
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <atomic>
+
+namespace lbind
+{
+	namespace
+	{
+		struct Compiled
+		{
+			std::string bytecode;
+			std::string error;
+		};
+
+		void compileWorker(const std::vector<Script>& scripts, std::vector<Compiled>& out, std::atomic<size_t>& next)
+		{
+			//One scratch state per worker, reused for every script it picks up.
+			lua_State * scratch = luaL_newstate();
+
+			//Nothing may escape a worker thread, so every failure is reported as the error of the
+			//script it happened on.
+			for (size_t i = next++; i < scripts.size(); i = next++)
+			{
+				const Script& script = scripts[i];
+				if (!scratch)
+				{
+					out[i].error = "Could not create a state to compile in";
+					continue;
+				}
+
+				try
+				{
+					if (luaL_loadbufferx(scratch, script.source.data(), script.source.size(), script.name.c_str(), "t") != LUA_OK)
+					{
+						out[i].error = lua_tostring(scratch, -1);
+					}
+					else
+					{
+						Detail::dumpFunction(scratch, -1, out[i].bytecode);
+					}
+				}
+				catch (const std::exception& e)
+				{
+					out[i].bytecode.clear();
+					out[i].error = e.what();
+				}
+				catch (...)
+				{
+					out[i].bytecode.clear();
+					out[i].error = "Unknown error while compiling";
+				}
+
+				lua_settop(scratch, 0);
+			}
+
+			if (scratch)
+			{
+				lua_close(scratch);
+			}
+		}
+	}
+
+	std::vector<CompileResult> compileParallel(lua_State * state, const std::vector<Script>& scripts, size_t threads)
+	{
+		if (threads == 0)
+		{
+			threads = std::max(1u, boost::thread::hardware_concurrency());
+		}
+
+		threads = std::min(threads, scripts.size());
+
+		std::vector<Compiled> compiled(scripts.size());
+		std::atomic<size_t> next(0);
+
+		boost::thread_group pool;
+		for (size_t i = 1; i < threads; ++i)
+		{
+			pool.create_thread([&]()
+			{
+				compileWorker(scripts, compiled, next);
+			});
+		}
+
+		//The calling thread works too, instead of just waiting.
+		compileWorker(scripts, compiled, next);
+		pool.join_all();
+
+		StackCheck check(state, 0, 0);
+
+		std::vector<CompileResult> results(scripts.size());
+		for (size_t i = 0; i < scripts.size(); ++i)
+		{
+			if (!compiled[i].error.empty())
+			{
+				results[i].error = std::move(compiled[i].error);
+				continue;
+			}
+
+			const std::string& bytecode = compiled[i].bytecode;
+			if (luaL_loadbufferx(state, bytecode.data(), bytecode.size(), scripts[i].name.c_str(), "b") != LUA_OK)
+			{
+				results[i].error = lua_tostring(state, -1);
+				lua_pop(state, 1);
+				continue;
+			}
+
+			results[i].function = Object::fromStack(state, -1);
+			lua_pop(state, 1);
+		}
+
+		return results;
+	}
+}
@@ -0,0 +1,165 @@
+#include "coroutinepool.hpp"
+#include "exceptions.hpp"
+
+namespace lbind
+{
+	PooledCoroutine::PooledCoroutine()
+		:pool(nullptr)
+		,thread(nullptr)
+		,ref(LUA_NOREF)
+		,count(0)
+	{}
+
+	PooledCoroutine::PooledCoroutine(CoroutinePool * pool, lua_State * thread, int ref)
+		:pool(pool)
+		,thread(thread)
+		,ref(ref)
+		,count(0)
+	{}
+
+	PooledCoroutine::PooledCoroutine(PooledCoroutine&& other)
+		:pool(other.pool)
+		,thread(other.thread)
+		,ref(other.ref)
+		,count(other.count)
+	{
+		other.pool = nullptr;
+		other.thread = nullptr;
+		other.ref = LUA_NOREF;
+		other.count = 0;
+	}
+
+	PooledCoroutine& PooledCoroutine::operator=(PooledCoroutine&& other)
+	{
+		if (this != &other)
+		{
+			release();
+			std::swap(pool, other.pool);
+			std::swap(thread, other.thread);
+			std::swap(ref, other.ref);
+			std::swap(count, other.count);
+		}
+
+		return *this;
+	}
+
+	PooledCoroutine::~PooledCoroutine()
+	{
+		release();
+	}
+
+	int PooledCoroutine::resume(int arguments)
+	{
+		count = 0;
+		return lua_resume(thread, pool->state(), arguments, &count);
+	}
+
+	int PooledCoroutine::results() const
+	{
+		return count;
+	}
+
+	lua_State * PooledCoroutine::get() const
+	{
+		return thread;
+	}
+
+	void PooledCoroutine::release()
+	{
+		if (pool)
+		{
+			pool->release(thread, ref);
+
+			pool = nullptr;
+			thread = nullptr;
+			ref = LUA_NOREF;
+			count = 0;
+		}
+	}
+
+	CoroutinePool::CoroutinePool(lua_State * state, const CoroutinePoolOptions& options)
+		:owner(state)
+		,options(options)
+		,made(0)
+	{
+		//Released coroutines are pushed back without growing the vector.
+		coroutines.reserve(options.capacity);
+
+		while (coroutines.size() < options.prewarm && coroutines.size() < options.capacity)
+		{
+			create();
+		}
+	}
+
+	CoroutinePool::~CoroutinePool()
+	{
+		for (const Idle& idle : coroutines)
+		{
+			luaL_unref(owner, LUA_REGISTRYINDEX, idle.ref);
+		}
+	}
+
+	PooledCoroutine CoroutinePool::acquire()
+	{
+		if (coroutines.empty())
+		{
+			create();
+		}
+
+		Idle idle = coroutines.back();
+
+		//Does nothing once the stack has room, which it keeps unless it was closed or shrunk.
+		if (!lua_checkstack(idle.thread, options.stackDepth))
+		{
+			throw LuaError("Not enough stack space for a pooled coroutine");
+		}
+
+		coroutines.pop_back();
+		return PooledCoroutine(this, idle.thread, idle.ref);
+	}
+
+	size_t CoroutinePool::idle() const
+	{
+		return coroutines.size();
+	}
+
+	size_t CoroutinePool::created() const
+	{
+		return made;
+	}
+
+	lua_State * CoroutinePool::state() const
+	{
+		return owner;
+	}
+
+	void CoroutinePool::create()
+	{
+		lua_State * thread = lua_newthread(owner);
+		int ref = luaL_ref(owner, LUA_REGISTRYINDEX);
+
+		coroutines.push_back(Idle{ thread, ref });
+		made++;
+	}
+
+	void CoroutinePool::release(lua_State * thread, int ref)
+	{
+		//A coroutine that returned, or never ran, is already back at its base call. Anything else
+		//has to be unwound, and resetting one that does not need it would only shrink its stack.
+		if (lua_status(thread) != LUA_OK)
+		{
+			lua_closethread(thread, owner);
+		}
+
+		lua_settop(thread, 0);
+
+		if (coroutines.size() < options.capacity)
+		{
+			coroutines.push_back(Idle{ thread, ref });
+		}
+		else
+		{
+			luaL_unref(owner, LUA_REGISTRYINDEX, ref);
+		}
+	}
+}
@@ -9,4 +9,8 @@ namespace lbind
 	BindingError::BindingError(const char * what)
 		:std::runtime_error(what)
 	{}
+
+	LuaError::LuaError(const char * what)
+		:std::runtime_error(what)
+	{}
 }
\ No newline at end of file
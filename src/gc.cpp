@@ -0,0 +1,176 @@
+#include "gc.hpp"
+#include "internal.hpp"
+#include "exceptions.hpp"
+
+#include <algorithm>
+
+namespace lbind
+{
+	namespace
+	{
+		typedef std::chrono::steady_clock Clock;
+
+		std::chrono::microseconds since(Clock::time_point start)
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+		}
+	}
+
+	GcController::GcController(lua_State * state, const GcOptions& options)
+		:state(state)
+		,options(options)
+		,wasRunning(false)
+		,wasGenerational(false)
+		,isGenerational(false)
+		,windowStart(Clock::now())
+		,allocated(0)
+		,heapAfterStep(0)
+		,externalAfterStep(0)
+		,rate(0)
+	{
+		Detail::InternalState * internal = Detail::getInternalState(state);
+		if (internal->gcController)
+		{
+			throw BindingError("A GcController is already attached to this state");
+		}
+
+		internal->gcController = this;
+
+		wasRunning = lua_gc(state, LUA_GCISRUNNING) != 0;
+		lua_gc(state, LUA_GCSTOP);
+
+		//There is no way to query the mode without setting it.
+		wasGenerational = lua_gc(state, LUA_GCINC, 0, 0, 0) == LUA_GCGEN;
+		isGenerational = false;
+
+		setGenerational(options.mode == GcOptions::Generational ||
+			(options.mode == GcOptions::Adaptive && wasGenerational));
+
+		heapAfterStep = heapBytes();
+		externalAfterStep = internal->externalMemory();
+	}
+
+	GcController::~GcController()
+	{
+		setGenerational(wasGenerational);
+
+		if (wasRunning)
+		{
+			lua_gc(state, LUA_GCRESTART);
+		}
+
+		//Gone if lbind::close ran first.
+		Detail::InternalState * internal = Detail::getInternalState(state);
+		if (internal)
+		{
+			internal->gcController = nullptr;
+		}
+	}
+
+	GcStep GcController::stepFor(std::chrono::microseconds budget)
+	{
+		measure();
+
+		GcStep result;
+		size_t before = heapBytes();
+
+		Clock::time_point start = Clock::now();
+		Clock::time_point deadline = start + budget;
+
+		do
+		{
+			Clock::time_point stepStart = Clock::now();
+			int finished = lua_gc(state, LUA_GCSTEP, 0);
+
+			result.longestPause = std::max(result.longestPause, since(stepStart));
+			result.steps++;
+
+			if (finished && !isGenerational)
+			{
+				result.cycles++;
+				break;
+			}
+		} while (!isGenerational && Clock::now() < deadline);
+
+		result.elapsed = since(start);
+
+		heapAfterStep = heapBytes();
+		externalAfterStep = Detail::getInternalState(state)->externalMemory();
+		result.collected = before > heapAfterStep ? before - heapAfterStep : 0;
+
+		total.elapsed += result.elapsed;
+		total.longestPause = std::max(total.longestPause, result.longestPause);
+		total.collected += result.collected;
+		total.steps += result.steps;
+		total.cycles += result.cycles;
+
+		return result;
+	}
+
+	bool GcController::generational() const
+	{
+		return isGenerational;
+	}
+
+	double GcController::allocationRate() const
+	{
+		return rate;
+	}
+
+	const GcStep& GcController::totals() const
+	{
+		return total;
+	}
+
+	size_t GcController::heapBytes() const
+	{
+		return static_cast<size_t>(lua_gc(state, LUA_GCCOUNT)) * 1024 + static_cast<size_t>(lua_gc(state, LUA_GCCOUNTB));
+	}
+
+	void GcController::measure()
+	{
+		//The collector is stopped, so the heap only shrinks inside stepFor and any growth since
+		//the last step was allocated by the host or its scripts.
+		size_t heap = heapBytes();
+		size_t external = Detail::getInternalState(state)->externalMemory();
+
+		allocated += heap > heapAfterStep ? heap - heapAfterStep : 0;
+		allocated += external > externalAfterStep ? external - externalAfterStep : 0;
+
+		std::chrono::microseconds elapsed = since(windowStart);
+		if (elapsed < options.window)
+		{
+			return;
+		}
+
+		rate = static_cast<double>(allocated) * 1000000.0 / static_cast<double>(std::max<boost::int64_t>(elapsed.count(), 1));
+
+		windowStart = Clock::now();
+		allocated = 0;
+
+		if (options.mode != GcOptions::Adaptive)
+		{
+			return;
+		}
+
+		if (!isGenerational && rate >= options.generationalRate)
+		{
+			setGenerational(true);
+		}
+		else if (isGenerational && rate <= options.incrementalRate)
+		{
+			setGenerational(false);
+		}
+	}
+
+	void GcController::setGenerational(bool on)
+	{
+		if (on == isGenerational)
+		{
+			return;
+		}
+
+		lua_gc(state, on ? LUA_GCGEN : LUA_GCINC, 0, 0, 0);
+		isGenerational = on;
+	}
+}
@@ -13,7 +13,10 @@ namespace lbind
 	void close(lua_State * state)
 	{
 		//Deallocate our storage object.
-		Detail::InternalState * s = *reinterpret_cast<Detail::InternalState **>(lua_getextraspace(state));
-		delete s;
+		Detail::InternalState ** s = reinterpret_cast<Detail::InternalState **>(lua_getextraspace(state));
+		delete *s;
+
+		//Objects lua owns are still collected by lua_close, after this.
+		*s = nullptr;
 	}
 }
\ No newline at end of file
@@ -1,22 +1,35 @@
 #include "internal.hpp"
 #include "function.hpp"
 
+#include <algorithm>
 #include <memory>
+#include <cassert>
+#include <climits>
 
 namespace lbind
 {
 	namespace Detail
 	{
+		InternalState::InternalState()
+			:profiler(nullptr)
+			,recorder(nullptr)
+			,gcController(nullptr)
+			,activeFunction(nullptr)
+			,eventLoop(nullptr)
+			,bindingDepth(0)
+			,externalBytes(0)
+			,externalDebt(0)
+		{
+			LBIND_STATISTIC(trackState(this));
+		}
+
 		InternalState::~InternalState()
 		{
-			for (size_t i = 0; i < allocations.size(); ++i)
-			{
-				free(allocations[i]);
-			}
+			LBIND_STATISTIC(retireState(this));
 
-			for (size_t i = 0; i < registeredFunctions.size(); ++i)
+			for (size_t i = destructors.size(); i-- > 0;)
 			{
-				delete registeredFunctions[i];
+				destructors[i].destroy(destructors[i].object);
 			}
 		}
 
@@ -25,14 +38,80 @@ namespace lbind
 			registeredFunctions.push_back(b);
 		}
 
-		void * InternalState::allocate(size_t bytes)
+		const std::vector<FunctionBase *>& InternalState::functions() const
 		{
-			void * result = malloc(bytes);
-			allocations.push_back(result);
+			return registeredFunctions;
+		}
+
+		const char * InternalState::copyString(boost::string_ref s)
+		{
+			char * result = static_cast<char *>(arena.allocate(s.size() + 1, 1));
+			std::copy(s.begin(), s.end(), result);
+			result[s.size()] = '\0';
 
 			return result;
 		}
 
+		void * InternalState::allocate(size_t bytes)
+		{
+			return arena.allocate(bytes);
+		}
+
+		size_t InternalState::metadataBytes() const
+		{
+			return arena.reserved();
+		}
+
+		void InternalState::addExternalMemory(lua_State * state, size_t bytes)
+		{
+			externalBytes += bytes;
+			if (gcController)
+			{
+				return;
+			}
+
+			externalDebt += bytes;
+
+			//Small objects are batched so that churning them does not run a step every time.
+			const size_t threshold = 16 * 1024;
+			if (externalDebt >= threshold)
+			{
+				int kilobytes = static_cast<int>(std::min<size_t>(externalDebt / 1024, INT_MAX));
+				externalDebt -= static_cast<size_t>(kilobytes) * 1024;
+
+				lua_gc(state, LUA_GCSTEP, kilobytes);
+			}
+		}
+
+		void InternalState::removeExternalMemory(size_t bytes)
+		{
+			externalBytes -= std::min(bytes, externalBytes);
+		}
+
+		size_t InternalState::externalMemory() const
+		{
+			return externalBytes;
+		}
+
+		void InternalState::retain(int ref)
+		{
+			size_t slot = static_cast<size_t>(ref);
+			if (slot >= referenceCounts.size())
+			{
+				referenceCounts.resize(slot + 1, 0);
+			}
+
+			referenceCounts[slot]++;
+		}
+
+		bool InternalState::release(int ref)
+		{
+			size_t slot = static_cast<size_t>(ref);
+			assert(slot < referenceCounts.size() && referenceCounts[slot] > 0);
+
+			return --referenceCounts[slot] == 0;
+		}
+
 		InternalState * getInternalState(lua_State * s)
 		{
 			return *reinterpret_cast<InternalState **>(lua_getextraspace(s));
@@ -0,0 +1,16 @@
+#include "luafunction.hpp"
+
+namespace lbind
+{
+	namespace Detail
+	{
+		void throwLuaError(lua_State * state)
+		{
+			const char * message = lua_tostring(state, -1);
+			LuaError error(message ? message : "(error object is not a string)");
+
+			lua_pop(state, 1);
+			throw error;
+		}
+	}
+}
@@ -95,28 +95,32 @@ int main(int argc, char * argv[])
 		.endclass()
 	.end();
 
-	Foo ff(42);
-	lbind::Object obj = lbind::newtable(state);
+	//Objects release their registry references when destroyed, so they must go before the state does.
+	{
+		Foo ff(42);
+		lbind::Object obj = lbind::newtable(state);
 
-	obj["kitty"] = 42;
-	obj["dog"] = obj["kitty"];
-	obj[1] = 2.5;
+		obj["kitty"] = 42;
+		obj["dog"] = obj["kitty"];
+		obj[1] = 2.5;
 
-	lbind::Object globals = lbind::globals(state);
-	globals["foo"] = ff;
+		lbind::Object globals = lbind::globals(state);
+		globals["foo"] = ff;
 
-	if (luaL_dofile(state, argv[1]))
-	{
-		const char * err = lua_tostring(state, -1);
-		std::cout << err << "\n";
-	}
+		if (luaL_dofile(state, argv[1]))
+		{
+			const char * err = lua_tostring(state, -1);
+			std::cout << err << "\n";
+		}
 
-	float f = globals["a"];
+		float f = globals["a"];
 
-	lbind::call<void>(globals["add"], 1, 52);
-	int res = lbind::call<int>(globals["sub"], 42, 1);
-	std::cout << "Result: " << res << "\n";
+		lbind::call<void>(globals["add"], 1, 52);
+		int res = lbind::call<int>(globals["sub"], 42, 1);
+		std::cout << "Result: " << res << "\n";
+	}
 
+	lbind::close(state);
 	lua_close(state);
 }
 #endif
@@ -1,17 +1,88 @@
 #include "object.h"
+#include "internal.hpp"
+#include "table_iter.hpp"
+
+#include <utility>
 
 namespace lbind
 {
 	Object::Object(lua_State * state, int index)
 		:interpreter(state)
 		,ind(index)
-	{}
+	{
+		retain();
+	}
 
 	Object::Object()
 		:interpreter(nullptr)
-		,ind(0)
+		,ind(LUA_NOREF)
 	{}
 
+	Object::Object(const Object& other)
+		:interpreter(other.interpreter)
+		,ind(other.ind)
+	{
+		retain();
+	}
+
+	Object::Object(Object&& other)
+		:interpreter(other.interpreter)
+		,ind(other.ind)
+	{
+		other.ind = LUA_NOREF;
+	}
+
+	Object::~Object()
+	{
+		release();
+	}
+
+	Object& Object::operator=(Object other)
+	{
+		swap(other);
+		return *this;
+	}
+
+	void Object::swap(Object& other)
+	{
+		std::swap(interpreter, other.interpreter);
+		std::swap(ind, other.ind);
+	}
+
+	//References at or below LUA_RIDX_LAST are either fixed registry entries, LUA_REFNIL or LUA_NOREF.
+	bool Object::owned() const
+	{
+		return interpreter && ind > LUA_RIDX_LAST;
+	}
+
+	//After lbind::close the counts are gone, and lua_close frees the registry with the rest of
+	//the state, so references are left alone.
+	void Object::retain()
+	{
+		if (owned())
+		{
+			Detail::InternalState * internal = Detail::getInternalState(interpreter);
+			if (internal)
+			{
+				internal->retain(ind);
+			}
+		}
+	}
+
+	void Object::release()
+	{
+		if (owned())
+		{
+			Detail::InternalState * internal = Detail::getInternalState(interpreter);
+			if (internal && internal->release(ind))
+			{
+				luaL_unref(interpreter, LUA_REGISTRYINDEX, ind);
+			}
+		}
+
+		ind = LUA_NOREF;
+	}
+
 	int Object::index() const
 	{
 		return ind;
@@ -44,6 +115,12 @@ namespace lbind
 		return lua_getfield(interpreter, -1, i.data());
 	}
 
+	int Object::stackPush(const Key * i) const
+	{
+		lua_rawgeti(interpreter, LUA_REGISTRYINDEX, ind);
+		return Detail::pushIndexed(interpreter, -1, i);
+	}
+
 	Detail::ObjectProxy<int, Object> Object::operator[](int i)
 	{
 		return Detail::ObjectProxy<int, Object>(this, i);
@@ -54,6 +131,11 @@ namespace lbind
 		return Detail::ObjectProxy<boost::string_ref, Object>(this, i);
 	}
 
+	Detail::ObjectProxy<const Key *, Object> Object::operator[](const Key& k)
+	{
+		return Detail::ObjectProxy<const Key *, Object>(this, &k);
+	}
+
 	StackObject Object::push()
 	{
 		lua_rawgeti(interpreter, LUA_REGISTRYINDEX, ind);
@@ -67,7 +149,10 @@ namespace lbind
 
 	Detail::Iterator Object::begin()
 	{
-		return Detail::Iterator(this);
+		int base = lua_gettop(interpreter);
+		lua_rawgeti(interpreter, LUA_REGISTRYINDEX, ind);
+
+		return Detail::Iterator(interpreter, -1, base);
 	}
 
 	Detail::Iterator Object::end()
@@ -97,6 +182,11 @@ namespace lbind
 		return lua_getfield(interpreter, canonical, i.data());
 	}
 
+	int StackObject::stackPush(const Key * i) const
+	{
+		return Detail::pushIndexed(interpreter, canonical, i);
+	}
+
 	Detail::ObjectProxy<int, StackObject> StackObject::operator[](int i)
 	{
 		return Detail::ObjectProxy<int, StackObject>(this, i);
@@ -107,6 +197,11 @@ namespace lbind
 		return Detail::ObjectProxy<boost::string_ref, StackObject>(this, i);
 	}
 
+	Detail::ObjectProxy<const Key *, StackObject> StackObject::operator[](const Key& k)
+	{
+		return Detail::ObjectProxy<const Key *, StackObject>(this, &k);
+	}
+
 	StackObject StackObject::push()
 	{
 		lua_pushvalue(interpreter, canonical);
@@ -133,14 +228,14 @@ namespace lbind
 		return interpreter;
 	}
 
-	Detail::StackIterator StackObject::begin()
+	Detail::Iterator StackObject::begin()
 	{
-		return Detail::StackIterator(this);
+		return Detail::Iterator(interpreter, canonical, lua_gettop(interpreter));
 	}
 
-	Detail::StackIterator StackObject::end()
+	Detail::Iterator StackObject::end()
 	{
-		return Detail::StackIterator();
+		return Detail::Iterator();
 	}
 
 	Object Object::fromStack(lua_State * state, int ind)
@@ -151,147 +246,81 @@ namespace lbind
 		return Object(state, ref);
 	}
 
-	Object newtable(lua_State * state)
+	Key::Key(lua_State * state, boost::string_ref name)
 	{
-		lua_newtable(state);
-		int ref = luaL_ref(state, LUA_REGISTRYINDEX);
-		return Object(state, ref);
+		StackCheck check(state, 1, 0);
+
+		lua_pushlstring(state, name.data(), name.size());
+		string = Object::fromStack(state, -1);
 	}
 
-	Object globals(lua_State * state)
+	Key::Key()
+	{}
+
+	void Key::push(lua_State * state) const
 	{
-		return Object(state, LUA_RIDX_GLOBALS);
+		lua_rawgeti(state, LUA_REGISTRYINDEX, string.index());
 	}
 
-	Object compile(lua_State * state, const char * data)
+	int Key::index() const
 	{
-		luaL_loadstring(state, data);
-		return Object::fromStack(state, -1);
+		return string.index();
 	}
 
-	namespace Detail
+	lua_State * Key::state() const
 	{
-		Iterator::Iterator(Object * o)
-			:o(o)
-			,hasNext(1)
-			,increments(0)
-		{
-			lua_pushnil(o->state());
-			currentIndex = Object::fromStack(o->state(), -1);
-
-			++(*this);
-		}
-
-		Iterator::Iterator()
-			:hasNext(0)
-			,increments(0)
-		{}
-
-		Iterator& Iterator::operator++()
-		{
-			StackCheck check(o->state(), 2, 0);
-
-			o->push();
-			currentIndex.push();
-
-			hasNext = lua_next(o->state(), -2);
-
-			currentIndex = Object::fromStack(o->state(), -2);
-			value = Object::fromStack(o->state(), -1);
-			increments++;
-
-			return *this;
-		}
-
-		Iterator Iterator::operator++(int)
-		{
-			Iterator it = *this;
-			++(*this);
-			return it;
-		}
-
-		Object Iterator::operator*()
-		{
-			return value;
-		}
-
-		Object Iterator::key()
-		{
-			return currentIndex;
-		}
-
-		bool Iterator::operator==(const Iterator& other)
-		{
-			return (other.hasNext == 0 && hasNext == 0) || (other.hasNext == 1 && hasNext == 1 && other.increments == increments);
-		}
-
-		bool Iterator::operator!=(const Iterator& other)
-		{
-			return !(*this == other);
-		}
-
-		StackIterator::StackIterator(StackObject * o)
-			:o(o)
-			,currentIndex(0)
-			,value(0)
-			,hasNext(1)
-			,increments(0)
-		{
-			lua_pushnil(o->state());
-			++(*this);
-		}
-
-		StackIterator::StackIterator()
-			:hasNext(0)
-			,increments(0)
-		{}
+		return string.state();
+	}
 
-		StackIterator& StackIterator::operator++()
+	namespace Detail
+	{
+		int pushIndexed(lua_State * state, int t, const Key * key)
 		{
-			if (value)
+			//Raw access is only defined for tables.
+			if (lua_type(state, t) != LUA_TTABLE)
 			{
-				//Pop value and fake key, keep key
-				lua_pop(o->state(), 2);
+				lua_pushnil(state);
+				return LUA_TNIL;
 			}
 
-			hasNext = lua_next(o->state(), o->index());
+			t = lua_absindex(state, t);
 
-			//Make a copy of the key, in case we call key() and cast to string.
-			lua_pushvalue(o->state(), -2);
-			currentIndex = lua_absindex(o->state(), -1);
-			value = lua_absindex(o->state(), -2);
-
-			increments++;
-
-			return *this;
+			key->push(state);
+			return lua_rawget(state, t);
 		}
 
-		StackIterator StackIterator::operator++(int)
+		void setIndexed(lua_State * state, int t, const Key * key)
 		{
-			StackIterator it = *this;
-			++(*this);
+			if (lua_type(state, t) != LUA_TTABLE)
+			{
+				lua_pop(state, 1);
+				throw BindingError("Keys can only be assigned to in tables");
+			}
 
-			return it;
-		}
+			//Stack is [value], and needs to be [key, value] for lua_rawset.
+			t = lua_absindex(state, t);
 
-		StackObject StackIterator::operator*()
-		{
-			return StackObject(o->state(), value);
+			key->push(state);
+			lua_insert(state, -2);
+			lua_rawset(state, t);
 		}
+	}
 
-		StackObject StackIterator::key()
-		{
-			return StackObject(o->state(), currentIndex);
-		}
+	Object newtable(lua_State * state)
+	{
+		lua_newtable(state);
+		int ref = luaL_ref(state, LUA_REGISTRYINDEX);
+		return Object(state, ref);
+	}
 
-		bool StackIterator::operator==(const StackIterator& other)
-		{
-			return (other.hasNext == 0 && hasNext == 0) || (other.hasNext == 1 && hasNext == 1 && other.increments == increments);
-		}
+	Object globals(lua_State * state)
+	{
+		return Object(state, LUA_RIDX_GLOBALS);
+	}
 
-		bool StackIterator::operator!=(const StackIterator& other)
-		{
-			return !(*this == other);
-		}
+	Object compile(lua_State * state, const char * data)
+	{
+		luaL_loadstring(state, data);
+		return Object::fromStack(state, -1);
 	}
 }
\ No newline at end of file
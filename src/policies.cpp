@@ -5,4 +5,6 @@ namespace lbind
 	null_policy_t null_policy;
 	returns_self_t returns_self;
 	ignore_return_t ignore_return;
+	stop_on_error_t stop_on_error;
+	continue_on_error_t continue_on_error;
 }
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "profiler.hpp"
+#include "function.hpp"
+#include "internal.hpp"
+#include "exceptions.hpp"
+
+#include <sstream>
+#include <vector>
+
+namespace lbind
+{
+	namespace
+	{
+		//Frames are separated by ';' and stacks by newlines, so neither can appear in a frame.
+		void appendFrame(std::string& out, const std::string& text)
+		{
+			for (char c : text)
+			{
+				out += (c == ';' || c == '\n') ? '_' : c;
+			}
+		}
+	}
+
+	Profiler::Profiler(lua_State * state, std::chrono::microseconds period)
+		:state(state)
+		,period(period)
+		,active(false)
+		,sampleCount(0)
+		,ticksInBound(0)
+		,bound(nullptr)
+		,stopping(false)
+	{}
+
+	Profiler::~Profiler()
+	{
+		stop();
+	}
+
+	void Profiler::start()
+	{
+		if (active)
+		{
+			return;
+		}
+
+		Detail::InternalState * internal = Detail::getInternalState(state);
+		if (internal->profiler)
+		{
+			throw BindingError("A profiler is already running on this state");
+		}
+
+		internal->profiler = this;
+		active = true;
+		stopping = false;
+		ticksInBound = 0;
+
+		timer = std::thread([this]()
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while (!wake.wait_for(guard, period, [this]() { return stopping; }))
+			{
+				tick();
+			}
+		});
+	}
+
+	void Profiler::stop()
+	{
+		if (!active)
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+
+		wake.notify_all();
+		timer.join();
+
+		lua_sethook(state, nullptr, 0, 0);
+		Detail::getInternalState(state)->profiler = nullptr;
+		active = false;
+	}
+
+	bool Profiler::running() const
+	{
+		return active;
+	}
+
+	size_t Profiler::samples() const
+	{
+		return sampleCount;
+	}
+
+	void Profiler::clear()
+	{
+		stacks.clear();
+		sampleCount = 0;
+	}
+
+	std::string Profiler::folded() const
+	{
+		std::ostringstream out;
+		writeFolded(out);
+
+		return out.str();
+	}
+
+	void Profiler::writeFolded(std::ostream& out) const
+	{
+		for (auto& entry : stacks)
+		{
+			out << entry.first << " " << entry.second << "\n";
+		}
+	}
+
+	//Runs on the timer thread.
+	void Profiler::tick()
+	{
+		Detail::FunctionBase * current = Detail::getInternalState(state)->activeFunction.load(std::memory_order_relaxed);
+
+		//Inside a bound function the hook cannot run until it returns, so count the ticks it takes.
+		if (current)
+		{
+			bound.store(current, std::memory_order_relaxed);
+			ticksInBound.fetch_add(1, std::memory_order_release);
+		}
+
+		//Arming the hook only when a sample is due keeps the VM off its slow path the rest of the time.
+		//lua_sethook is safe to call asynchronously, this is what it is designed for.
+		lua_sethook(state, &Profiler::hook, LUA_MASKCOUNT, 1);
+	}
+
+	void Profiler::hook(lua_State * state, lua_Debug *)
+	{
+		lua_sethook(state, nullptr, 0, 0);
+
+		Profiler * self = Detail::getInternalState(state)->profiler;
+		if (self)
+		{
+			self->sample(state);
+		}
+	}
+
+	void Profiler::sample(lua_State * s)
+	{
+		std::string base = stack(s);
+
+		boost::uint32_t ticks = ticksInBound.exchange(0, std::memory_order_acquire);
+		if (ticks)
+		{
+			std::string frame = base + ";";
+			appendFrame(frame, std::string("[C++] ") + bound.load(std::memory_order_relaxed)->name);
+
+			stacks[frame] += ticks;
+			sampleCount += ticks;
+			return;
+		}
+
+		stacks[base]++;
+		sampleCount++;
+	}
+
+	std::string Profiler::stack(lua_State * s) const
+	{
+		std::vector<std::string> frames;
+
+		lua_Debug ar;
+		for (int level = 0; lua_getstack(s, level, &ar); ++level)
+		{
+			lua_getinfo(s, "Snf", &ar);
+
+			std::string frame;
+			if (lua_tocfunction(s, -1) == &Detail::FunctionBase::apply)
+			{
+				//Bound functions are named after what they were registered as.
+				lua_getupvalue(s, -1, 1);
+				Detail::FunctionBase * f = static_cast<Detail::FunctionBase *>(lua_touserdata(s, -1));
+				lua_pop(s, 1);
+
+				frame = std::string("[C++] ") + f->name;
+			}
+			else if (*ar.what == 'm')
+			{
+				frame = std::string("main ") + ar.short_src;
+			}
+			else
+			{
+				frame = std::string(ar.name ? ar.name : "?") + " " + ar.short_src + ":" + std::to_string(ar.linedefined);
+			}
+
+			lua_pop(s, 1);
+			frames.push_back(frame);
+		}
+
+		//Folded stacks go from the outermost frame in.
+		std::string result;
+		for (size_t i = frames.size(); i-- > 0;)
+		{
+			if (!result.empty())
+			{
+				result += ";";
+			}
+
+			appendFrame(result, frames[i]);
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,321 @@
+#include "recorder.hpp"
+#include "function.hpp"
+#include "exceptions.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+
+namespace lbind
+{
+	namespace
+	{
+		//Written out once the buffer reaches this, so recording does not touch the file per call.
+		const size_t flushThreshold = 64 * 1024;
+
+		const boost::uint32_t unknownBinding = 0xFFFFFFFF;
+	}
+
+	Recorder::Recorder(lua_State * state, const std::string& path)
+		:state(state)
+		,path(path)
+		,active(false)
+		,sequence(0)
+	{}
+
+	Recorder::~Recorder()
+	{
+		stop();
+	}
+
+	void Recorder::start()
+	{
+		if (active)
+		{
+			return;
+		}
+
+		Detail::InternalState * internal = Detail::getInternalState(state);
+		if (internal->recorder)
+		{
+			throw BindingError("A recorder is already running on this state");
+		}
+
+		//Stopping and starting again keeps appending to the same trace.
+		if (!file.is_open())
+		{
+			file.open(path, std::ios::binary | std::ios::trunc);
+			if (!file)
+			{
+				throw BindingError(fmt::format("Could not open {} to record a trace", path).c_str());
+			}
+
+			buffer.append("LBTR", 4);
+			for (int i = 0; i < 4; ++i)
+			{
+				buffer.push_back(static_cast<char>((version >> (i * 8)) & 0xFF));
+			}
+		}
+
+		internal->recorder = this;
+		active = true;
+		last = std::chrono::steady_clock::now();
+	}
+
+	void Recorder::stop()
+	{
+		if (!active)
+		{
+			return;
+		}
+
+		//Gone if lbind::close ran first.
+		Detail::InternalState * internal = Detail::getInternalState(state);
+		if (internal)
+		{
+			internal->recorder = nullptr;
+		}
+
+		active = false;
+
+		flush();
+		file.flush();
+	}
+
+	bool Recorder::running() const
+	{
+		return active;
+	}
+
+	size_t Recorder::calls() const
+	{
+		return sequence;
+	}
+
+	size_t Recorder::enterBinding(lua_State * l, Detail::FunctionBase * function, int count)
+	{
+		boost::uint32_t id;
+
+		auto found = ids[Binding].find(function);
+		if (found != ids[Binding].end())
+		{
+			id = found->second;
+		}
+		else
+		{
+			//Only looked up the first time a binding is called.
+			const std::vector<Detail::FunctionBase *>& functions = Detail::getInternalState(l)->functions();
+			auto position = std::find(functions.begin(), functions.end(), function);
+
+			id = position != functions.end() ? static_cast<boost::uint32_t>(position - functions.begin()) : unknownBinding;
+			define(Binding, function, id, function->name);
+		}
+
+		int first = lua_gettop(l) - count + 1;
+		defineClasses(l, first, count);
+
+		buffer.push_back(BindingCall);
+		writeTimestamp();
+		writeVarint(id);
+		writeArguments(l, first, count);
+
+		return ++sequence;
+	}
+
+	size_t Recorder::enterLua(lua_State * l, int count)
+	{
+		int function = lua_gettop(l) - count;
+		const void * key = lua_topointer(l, function);
+
+		boost::uint32_t id;
+
+		auto found = ids[LuaFunction].find(key);
+		if (found != ids[LuaFunction].end())
+		{
+			id = found->second;
+		}
+		else
+		{
+			lua_Debug ar;
+			lua_pushvalue(l, function);
+			lua_getinfo(l, ">S", &ar);
+
+			id = define(LuaFunction, key, static_cast<boost::uint32_t>(ids[LuaFunction].size()), fmt::format("{}:{}", ar.short_src, ar.linedefined));
+		}
+
+		defineClasses(l, function + 1, count);
+
+		buffer.push_back(LuaCall);
+		writeTimestamp();
+		writeVarint(id);
+		writeArguments(l, function + 1, count);
+
+		return ++sequence;
+	}
+
+	void Recorder::leave(size_t call, int results)
+	{
+		buffer.push_back(Return);
+		writeTimestamp();
+		writeVarint(call);
+		writeVarint(static_cast<boost::uint64_t>(std::max(results, 0)));
+
+		if (buffer.size() >= flushThreshold)
+		{
+			flush();
+		}
+	}
+
+	boost::uint32_t Recorder::define(Kind kind, const void * key, boost::uint32_t id, const std::string& name)
+	{
+		ids[kind][key] = id;
+
+		buffer.push_back(Define);
+		buffer.push_back(static_cast<char>(kind));
+		writeVarint(id);
+		writeString(name.data(), name.size());
+
+		return id;
+	}
+
+	boost::uint32_t Recorder::classOf(lua_State * l, int index)
+	{
+		bool hasMetatable = lua_getmetatable(l, index) != 0;
+		const void * key = hasMetatable ? lua_topointer(l, -1) : nullptr;
+
+		auto found = ids[Class].find(key);
+		if (found != ids[Class].end())
+		{
+			if (hasMetatable)
+			{
+				lua_pop(l, 1);
+			}
+
+			return found->second;
+		}
+
+		//Bound classes name their instance metatable, as luaL_newmetatable does.
+		std::string name;
+		if (hasMetatable)
+		{
+			if (lua_getfield(l, -1, "__name") == LUA_TSTRING)
+			{
+				name = lua_tostring(l, -1);
+			}
+
+			lua_pop(l, 2);
+		}
+
+		return define(Class, key, static_cast<boost::uint32_t>(ids[Class].size()), name);
+	}
+
+	void Recorder::defineClasses(lua_State * l, int first, int count)
+	{
+		//Names go before the record that uses them.
+		for (int i = first; i < first + count; ++i)
+		{
+			if (lua_type(l, i) == LUA_TUSERDATA)
+			{
+				classOf(l, i);
+			}
+		}
+	}
+
+	void Recorder::writeArguments(lua_State * l, int first, int count)
+	{
+		writeVarint(static_cast<boost::uint64_t>(count));
+
+		for (int i = first; i < first + count; ++i)
+		{
+			switch (lua_type(l, i))
+			{
+			case LUA_TNIL:
+				buffer.push_back(Nil);
+				break;
+			case LUA_TBOOLEAN:
+				buffer.push_back(lua_toboolean(l, i) ? True : False);
+				break;
+			case LUA_TNUMBER:
+				if (lua_isinteger(l, i))
+				{
+					buffer.push_back(Integer);
+					writeSigned(lua_tointeger(l, i));
+				}
+				else
+				{
+					//Host byte order: traces are replayed on the machine that recorded them.
+					lua_Number n = lua_tonumber(l, i);
+					char bytes[sizeof(n)];
+					std::memcpy(bytes, &n, sizeof(n));
+
+					buffer.push_back(Number);
+					buffer.append(bytes, sizeof(n));
+				}
+				break;
+			case LUA_TSTRING:
+				{
+					size_t length = 0;
+					const char * text = lua_tolstring(l, i, &length);
+
+					buffer.push_back(String);
+					writeString(text, std::min(length, maxString));
+				}
+				break;
+			case LUA_TTABLE:
+				buffer.push_back(Table);
+				break;
+			case LUA_TFUNCTION:
+				buffer.push_back(Function);
+				break;
+			case LUA_TUSERDATA:
+				{
+					boost::uint32_t id = classOf(l, i);
+					buffer.push_back(Userdata);
+					writeVarint(id);
+				}
+				break;
+			case LUA_TLIGHTUSERDATA:
+				buffer.push_back(LightUserdata);
+				break;
+			default:
+				buffer.push_back(Thread);
+				break;
+			}
+		}
+	}
+
+	void Recorder::writeTimestamp()
+	{
+		auto now = std::chrono::steady_clock::now();
+		writeVarint(static_cast<boost::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count()));
+		last = now;
+	}
+
+	void Recorder::writeVarint(boost::uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			buffer.push_back(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+
+		buffer.push_back(static_cast<char>(value));
+	}
+
+	void Recorder::writeSigned(boost::int64_t value)
+	{
+		writeVarint((static_cast<boost::uint64_t>(value) << 1) ^ static_cast<boost::uint64_t>(value >> 63));
+	}
+
+	void Recorder::writeString(const char * text, size_t length)
+	{
+		writeVarint(length);
+		buffer.append(text, length);
+	}
+
+	void Recorder::flush()
+	{
+		file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		buffer.clear();
+	}
+}
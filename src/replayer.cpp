@@ -0,0 +1,357 @@
+#include "replayer.hpp"
+#include "function.hpp"
+#include "exceptions.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <fmt/format.h>
+
+namespace lbind
+{
+	namespace
+	{
+		struct Reader
+		{
+			Reader(const std::string& data, const std::string& path)
+				:data(data)
+				,path(path)
+				,position(0)
+			{}
+
+			bool done() const
+			{
+				return position >= data.size();
+			}
+
+			unsigned char byte()
+			{
+				if (done())
+				{
+					fail("ends in the middle of a record");
+				}
+
+				return static_cast<unsigned char>(data[position++]);
+			}
+
+			boost::uint64_t varint()
+			{
+				boost::uint64_t result = 0;
+				for (int shift = 0; shift < 64; shift += 7)
+				{
+					unsigned char b = byte();
+					result |= static_cast<boost::uint64_t>(b & 0x7F) << shift;
+
+					if (!(b & 0x80))
+					{
+						return result;
+					}
+				}
+
+				fail("has an integer that is too long");
+				return 0;
+			}
+
+			boost::int64_t zigzag()
+			{
+				boost::uint64_t value = varint();
+				return static_cast<boost::int64_t>(value >> 1) ^ -static_cast<boost::int64_t>(value & 1);
+			}
+
+			std::string string()
+			{
+				boost::uint64_t length = varint();
+				if (length > data.size() - position)
+				{
+					fail("ends in the middle of a string");
+				}
+
+				std::string result = data.substr(position, static_cast<size_t>(length));
+				position += static_cast<size_t>(length);
+
+				return result;
+			}
+
+			void bytes(void * out, size_t count)
+			{
+				if (count > data.size() - position)
+				{
+					fail("ends in the middle of a record");
+				}
+
+				std::memcpy(out, data.data() + position, count);
+				position += count;
+			}
+
+			void fail(const char * what) const
+			{
+				throw BindingError(fmt::format("{} is not a valid trace: it {}", path, what).c_str());
+			}
+
+			const std::string& data;
+			const std::string& path;
+			size_t position;
+		};
+	}
+
+	Replayer::Replayer(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			throw BindingError(fmt::format("Could not open trace {}", path).c_str());
+		}
+
+		std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		Reader in(data, path);
+		if (data.size() < 8 || data.compare(0, 4, "LBTR") != 0)
+		{
+			in.fail("does not start with the trace header");
+		}
+
+		in.position = 4;
+
+		boost::uint32_t version = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			version |= static_cast<boost::uint32_t>(in.byte()) << (i * 8);
+		}
+
+		if (version != Recorder::version)
+		{
+			in.fail("was written by a different version of the recorder");
+		}
+
+		//Calls that have started but not returned, as indices into records.
+		std::vector<size_t> open;
+		std::chrono::nanoseconds now(0);
+
+		while (!in.done())
+		{
+			unsigned char tag = in.byte();
+			switch (tag)
+			{
+			case Recorder::Define:
+				{
+					unsigned char kind = in.byte();
+					if (kind > Recorder::Class)
+					{
+						in.fail("defines an unknown kind of name");
+					}
+
+					boost::uint32_t id = static_cast<boost::uint32_t>(in.varint());
+					names[kind][id] = in.string();
+				}
+				break;
+			case Recorder::BindingCall:
+			case Recorder::LuaCall:
+				{
+					now += std::chrono::nanoseconds(in.varint());
+
+					Call call;
+					call.tag = static_cast<Recorder::Tag>(tag);
+					call.id = static_cast<boost::uint32_t>(in.varint());
+					call.parent = open.empty() ? 0 : open.back() + 1;
+					call.start = now;
+					call.duration = std::chrono::nanoseconds(0);
+
+					boost::uint64_t count = in.varint();
+					for (boost::uint64_t i = 0; i < count; ++i)
+					{
+						Value value;
+						value.tag = static_cast<Recorder::ValueTag>(in.byte());
+						value.integer = 0;
+						value.number = 0;
+
+						switch (value.tag)
+						{
+						case Recorder::Integer:
+							value.integer = static_cast<lua_Integer>(in.zigzag());
+							break;
+						case Recorder::Number:
+							in.bytes(&value.number, sizeof(value.number));
+							break;
+						case Recorder::String:
+							value.text = in.string();
+							break;
+						case Recorder::Userdata:
+							value.text = names[Recorder::Class][static_cast<boost::uint32_t>(in.varint())];
+							break;
+						default:
+							if (value.tag > Recorder::Thread)
+							{
+								in.fail("has an argument of an unknown type");
+							}
+							break;
+						}
+
+						call.arguments.push_back(std::move(value));
+					}
+
+					open.push_back(records.size());
+					records.push_back(std::move(call));
+				}
+				break;
+			case Recorder::Return:
+				{
+					now += std::chrono::nanoseconds(in.varint());
+
+					size_t sequence = static_cast<size_t>(in.varint());
+					in.varint();
+
+					//A call that raised a Lua error never returns, so its callers may return
+					//without it. Returns for calls that are not open are ignored.
+					for (size_t i = open.size(); i-- > 0;)
+					{
+						if (open[i] + 1 == sequence)
+						{
+							for (size_t j = i; j < open.size(); ++j)
+							{
+								Call& closed = records[open[j]];
+								closed.duration = now - closed.start;
+							}
+
+							open.resize(i);
+							break;
+						}
+					}
+				}
+				break;
+			default:
+				in.fail("has an unknown record");
+			}
+		}
+	}
+
+	size_t Replayer::calls() const
+	{
+		return records.size();
+	}
+
+	void Replayer::map(const std::string& name, Object function)
+	{
+		mapped[name] = function;
+	}
+
+	void Replayer::substitute(const std::string& className, std::function<void(lua_State *)> push)
+	{
+		substitutes[className] = std::move(push);
+	}
+
+	ReplayResult Replayer::replay(lua_State * state) const
+	{
+		StackCheck check(state, 0, 0);
+		ReplayResult result;
+
+		//Whether each call was made, or happened within one that was.
+		std::vector<bool> covered(records.size(), false);
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < records.size(); ++i)
+		{
+			const Call& call = records[i];
+			if (call.parent && covered[call.parent - 1])
+			{
+				covered[i] = true;
+				continue;
+			}
+
+			if (!push(state, call))
+			{
+				result.skipped++;
+				continue;
+			}
+
+			for (const Value& value : call.arguments)
+			{
+				push(state, value);
+			}
+
+			covered[i] = true;
+			result.calls++;
+			result.recorded += call.duration;
+
+			if (lua_pcall(state, static_cast<int>(call.arguments.size()), 0, 0) != LUA_OK)
+			{
+				result.failed++;
+				lua_pop(state, 1);
+			}
+		}
+
+		result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+		return result;
+	}
+
+	bool Replayer::push(lua_State * state, const Call& call) const
+	{
+		const Recorder::Kind kind = call.tag == Recorder::BindingCall ? Recorder::Binding : Recorder::LuaFunction;
+
+		auto name = names[kind].find(call.id);
+		if (name == names[kind].end())
+		{
+			return false;
+		}
+
+		auto found = mapped.find(name->second);
+		if (found != mapped.end())
+		{
+			lua_rawgeti(state, LUA_REGISTRYINDEX, found->second.index());
+			return true;
+		}
+
+		if (kind != Recorder::Binding)
+		{
+			return false;
+		}
+
+		//Bound the same way, so the same function is at the same index.
+		const std::vector<Detail::FunctionBase *>& functions = Detail::getInternalState(state)->functions();
+		if (call.id >= functions.size() || name->second != functions[call.id]->name)
+		{
+			return false;
+		}
+
+		lua_pushlightuserdata(state, functions[call.id]);
+		lua_pushcclosure(state, &Detail::FunctionBase::apply, 1);
+		return true;
+	}
+
+	void Replayer::push(lua_State * state, const Value& value) const
+	{
+		switch (value.tag)
+		{
+		case Recorder::False:
+		case Recorder::True:
+			lua_pushboolean(state, value.tag == Recorder::True);
+			break;
+		case Recorder::Integer:
+			lua_pushinteger(state, value.integer);
+			break;
+		case Recorder::Number:
+			lua_pushnumber(state, value.number);
+			break;
+		case Recorder::String:
+			lua_pushlstring(state, value.text.data(), value.text.size());
+			break;
+		case Recorder::Table:
+			lua_newtable(state);
+			break;
+		case Recorder::Userdata:
+			{
+				auto found = substitutes.find(value.text);
+				if (found != substitutes.end())
+				{
+					found->second(state);
+					break;
+				}
+			}
+
+			lua_pushnil(state);
+			break;
+		default:
+			lua_pushnil(state);
+			break;
+		}
+	}
+}
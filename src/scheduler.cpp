@@ -0,0 +1,188 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+namespace lbind
+{
+	namespace
+	{
+		//The scheduler whose worker this thread is, if any, so jobs submitted from a job stay
+		//on the worker that submitted them.
+		thread_local Scheduler * currentScheduler = nullptr;
+		thread_local size_t currentWorker = 0;
+	}
+
+	Scheduler::Scheduler(std::function<void(lua_State *)> setup, const SchedulerOptions& options)
+		:queued(0)
+		,next(0)
+		,steals(0)
+		,stopping(false)
+	{
+		size_t count = options.workers;
+		if (count == 0)
+		{
+			count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+		}
+
+		//Reserved up front, so that a state is never created without a place to keep it.
+		pool.reserve(count);
+
+		try
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				std::unique_ptr<Worker> worker(new Worker());
+				worker->state = newstate(options.state);
+
+				pool.push_back(std::move(worker));
+				setup(pool.back()->state);
+			}
+		}
+		catch (...)
+		{
+			for (auto& worker : pool)
+			{
+				if (worker->state)
+				{
+					closestate(worker->state);
+				}
+			}
+
+			throw;
+		}
+
+		//Only once every state is set up, since registration can not run alongside anything.
+		for (size_t i = 0; i < pool.size(); ++i)
+		{
+			pool[i]->thread = std::thread([this, i]() {
+				work(i);
+			});
+		}
+	}
+
+	Scheduler::~Scheduler()
+	{
+		{
+			std::lock_guard<std::mutex> held(sleep);
+			stopping = true;
+		}
+
+		wake.notify_all();
+
+		for (auto& worker : pool)
+		{
+			worker->thread.join();
+		}
+
+		for (auto& worker : pool)
+		{
+			closestate(worker->state);
+		}
+	}
+
+	size_t Scheduler::workers() const
+	{
+		return pool.size();
+	}
+
+	size_t Scheduler::stolen() const
+	{
+		return steals;
+	}
+
+	size_t Scheduler::pending() const
+	{
+		return queued;
+	}
+
+	void Scheduler::push(std::unique_ptr<Detail::Job> job)
+	{
+		size_t index = currentScheduler == this ? currentWorker : next++ % pool.size();
+
+		//Counted before it is queued, so that taking it never sees the count drop below zero.
+		queued++;
+		{
+			std::lock_guard<std::mutex> held(pool[index]->lock);
+			pool[index]->jobs.push_back(std::move(job));
+		}
+
+		//Taking the lock orders this after a worker checking for work and going to sleep.
+		{
+			std::lock_guard<std::mutex> held(sleep);
+		}
+
+		wake.notify_one();
+	}
+
+	void Scheduler::work(size_t index)
+	{
+		currentScheduler = this;
+		currentWorker = index;
+
+		lua_State * state = pool[index]->state;
+		for (;;)
+		{
+			std::unique_ptr<Detail::Job> job = take(index);
+			if (!job)
+			{
+				job = steal(index);
+			}
+
+			if (job)
+			{
+				job->run(state);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> held(sleep);
+			wake.wait(held, [this]() { return queued > 0 || stopping; });
+
+			if (stopping && queued == 0)
+			{
+				break;
+			}
+		}
+
+		currentScheduler = nullptr;
+	}
+
+	std::unique_ptr<Detail::Job> Scheduler::take(size_t index)
+	{
+		Worker& worker = *pool[index];
+
+		std::lock_guard<std::mutex> held(worker.lock);
+		if (worker.jobs.empty())
+		{
+			return nullptr;
+		}
+
+		std::unique_ptr<Detail::Job> job = std::move(worker.jobs.front());
+		worker.jobs.pop_front();
+		queued--;
+
+		return job;
+	}
+
+	std::unique_ptr<Detail::Job> Scheduler::steal(size_t thief)
+	{
+		for (size_t i = 1; i < pool.size(); ++i)
+		{
+			Worker& victim = *pool[(thief + i) % pool.size()];
+
+			std::lock_guard<std::mutex> held(victim.lock);
+			if (victim.jobs.empty())
+			{
+				continue;
+			}
+
+			std::unique_ptr<Detail::Job> job = std::move(victim.jobs.back());
+			victim.jobs.pop_back();
+			queued--;
+			steals++;
+
+			return job;
+		}
+
+		return nullptr;
+	}
+}
@@ -0,0 +1,290 @@
+#include "state.hpp"
+#include "arena.hpp"
+#include "init.hpp"
+#include "internal.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace lbind
+{
+	namespace Detail
+	{
+		//Size class free lists over an arena, with accounting.
+		class PoolAllocator
+		{
+		public:
+			static const size_t granularity = 16;
+			static const size_t classes = 16;
+			static const size_t largest = granularity * classes;
+
+			explicit PoolAllocator(const StateOptions& options)
+				:arena(options.arenaBlockSize)
+				,live(0)
+				,peak(0)
+				,limit(options.memoryLimit)
+				,large(0)
+				,refused(0)
+			{
+				std::fill(freeLists, freeLists + classes, nullptr);
+			}
+
+			static void * allocate(void * ud, void * ptr, size_t osize, size_t nsize)
+			{
+				return static_cast<PoolAllocator *>(ud)->reallocate(ptr, osize, nsize);
+			}
+
+			void * reallocate(void * ptr, size_t osize, size_t nsize)
+			{
+				//Without a block, osize is the type of object being allocated.
+				if (!ptr)
+				{
+					osize = 0;
+				}
+
+				if (nsize == 0)
+				{
+					release(ptr, osize);
+					live -= osize;
+					return nullptr;
+				}
+
+				if (nsize > osize && limit && live - osize + nsize > limit)
+				{
+					refused++;
+					return nullptr;
+				}
+
+				//Same size class, nothing to move.
+				if (ptr && osize <= largest && nsize <= largest && sizeClass(osize) == sizeClass(nsize))
+				{
+					account(osize, nsize);
+					return ptr;
+				}
+
+				if (ptr && osize > largest && nsize > largest)
+				{
+					void * result = std::realloc(ptr, nsize);
+					if (!result)
+					{
+						return shrinkInPlace(ptr, osize, nsize);
+					}
+
+					large += nsize - osize;
+					account(osize, nsize);
+					return result;
+				}
+
+				void * result = obtain(nsize);
+				if (!result)
+				{
+					return shrinkInPlace(ptr, osize, nsize);
+				}
+
+				if (ptr)
+				{
+					std::memcpy(result, ptr, osize < nsize ? osize : nsize);
+					release(ptr, osize);
+				}
+
+				account(osize, nsize);
+				return result;
+			}
+
+			MemoryUsage usage() const
+			{
+				MemoryUsage result;
+				result.live = live;
+				result.peak = peak;
+				result.limit = limit;
+				result.reserved = arena.reserved() + large;
+				result.refused = refused;
+
+				return result;
+			}
+
+			void setLimit(size_t l)
+			{
+				limit = l;
+			}
+		private:
+			struct FreeBlock
+			{
+				FreeBlock * next;
+			};
+
+			static size_t sizeClass(size_t bytes)
+			{
+				return (bytes - 1) / granularity;
+			}
+
+			void * obtain(size_t bytes)
+			{
+				if (bytes > largest)
+				{
+					void * result = std::malloc(bytes);
+					if (result)
+					{
+						large += bytes;
+					}
+
+					return result;
+				}
+
+				size_t c = sizeClass(bytes);
+				if (FreeBlock * block = freeLists[c])
+				{
+					freeLists[c] = block->next;
+					return block;
+				}
+
+				try
+				{
+					return arena.allocate((c + 1) * granularity);
+				}
+				catch (const std::bad_alloc&)
+				{
+					return nullptr;
+				}
+			}
+
+			//Lua assumes shrinking never fails, so a block that can not be moved somewhere smaller
+			//stays where it is. It is only ever used as nsize bytes from then on, and freed as that
+			//much, which leaves any malloc'd block in a free list rather than given back.
+			void * shrinkInPlace(void * ptr, size_t osize, size_t nsize)
+			{
+				if (!ptr || nsize > osize)
+				{
+					return nullptr;
+				}
+
+				if (nsize > largest)
+				{
+					large += nsize - osize;
+				}
+
+				account(osize, nsize);
+				return ptr;
+			}
+
+			void release(void * ptr, size_t bytes)
+			{
+				if (!ptr)
+				{
+					return;
+				}
+
+				if (bytes > largest)
+				{
+					std::free(ptr);
+					large -= bytes;
+					return;
+				}
+
+				FreeBlock * block = static_cast<FreeBlock *>(ptr);
+				block->next = freeLists[sizeClass(bytes)];
+				freeLists[sizeClass(bytes)] = block;
+			}
+
+			void account(size_t osize, size_t nsize)
+			{
+				live = live - osize + nsize;
+				if (live > peak)
+				{
+					peak = live;
+				}
+			}
+
+			Arena arena;
+			FreeBlock * freeLists[classes];
+
+			size_t live;
+			size_t peak;
+			size_t limit;
+			size_t large;
+			size_t refused;
+		};
+
+		namespace
+		{
+			int panic(lua_State * state)
+			{
+				const char * message = lua_tostring(state, -1);
+				std::fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", message ? message : "error object is not a string");
+				return 0;
+			}
+
+			PoolAllocator * poolAllocator(lua_State * state)
+			{
+				void * ud = nullptr;
+				if (lua_getallocf(state, &ud) != &PoolAllocator::allocate)
+				{
+					return nullptr;
+				}
+
+				return static_cast<PoolAllocator *>(ud);
+			}
+		}
+	}
+
+	lua_State * newstate(const StateOptions& options)
+	{
+		Detail::PoolAllocator * allocator = new Detail::PoolAllocator(options);
+
+		lua_State * state = lua_newstate(&Detail::PoolAllocator::allocate, allocator);
+		if (!state)
+		{
+			delete allocator;
+			throw std::bad_alloc();
+		}
+
+		lua_atpanic(state, Detail::panic);
+		open(state);
+
+		if (options.openLibraries)
+		{
+			luaL_openlibs(state);
+		}
+
+		return state;
+	}
+
+	void closestate(lua_State * state)
+	{
+		Detail::PoolAllocator * allocator = Detail::poolAllocator(state);
+
+		close(state);
+		lua_close(state);
+
+		//Everything left in the free lists goes with the arena.
+		delete allocator;
+	}
+
+	MemoryUsage memoryUsage(lua_State * state)
+	{
+		Detail::PoolAllocator * allocator = Detail::poolAllocator(state);
+		if (!allocator)
+		{
+			MemoryUsage none = {};
+			return none;
+		}
+
+		return allocator->usage();
+	}
+
+	void setMemoryLimit(lua_State * state, size_t limit)
+	{
+		if (Detail::PoolAllocator * allocator = Detail::poolAllocator(state))
+		{
+			allocator->setLimit(limit);
+		}
+	}
+
+	size_t externalMemory(lua_State * state)
+	{
+		return Detail::getInternalState(state)->externalMemory();
+	}
+}
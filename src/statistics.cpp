@@ -0,0 +1,278 @@
+#include "statistics.hpp"
+#include "internal.hpp"
+#include "function.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace lbind
+{
+	Histogram::Histogram()
+		:samples(0)
+		,totalNanoseconds(0)
+	{
+		std::fill(counts, counts + buckets, 0);
+	}
+
+	void Histogram::record(boost::uint64_t nanoseconds)
+	{
+		size_t bucket = 0;
+		for (boost::uint64_t n = nanoseconds; n > 1 && bucket + 1 < buckets; n >>= 1)
+		{
+			bucket++;
+		}
+
+		counts[bucket]++;
+		samples++;
+		totalNanoseconds += nanoseconds;
+	}
+
+	void Histogram::merge(const Histogram& other)
+	{
+		for (size_t i = 0; i < buckets; ++i)
+		{
+			counts[i] += other.counts[i];
+		}
+
+		samples += other.samples;
+		totalNanoseconds += other.totalNanoseconds;
+	}
+
+	boost::uint64_t Histogram::percentile(double fraction) const
+	{
+		boost::uint64_t wanted = static_cast<boost::uint64_t>(fraction * samples + 0.5);
+		boost::uint64_t seen = 0;
+
+		for (size_t i = 0; i < buckets; ++i)
+		{
+			seen += counts[i];
+			if (seen >= wanted && seen > 0)
+			{
+				return boost::uint64_t(2) << i;
+			}
+		}
+
+		return 0;
+	}
+
+	FunctionStatistics::FunctionStatistics()
+		:calls(0)
+		,overloadMisses(0)
+	{}
+
+	Statistics::Statistics()
+		:converts(0)
+		,convertedBytes(0)
+		,luaToC(0)
+		,cToLua(0)
+		,overloadMisses(0)
+	{}
+
+	void Statistics::merge(const Statistics& other)
+	{
+		converts += other.converts;
+		convertedBytes += other.convertedBytes;
+		luaToC += other.luaToC;
+		cToLua += other.cToLua;
+		overloadMisses += other.overloadMisses;
+
+		luaToCLatency.merge(other.luaToCLatency);
+		cToLuaLatency.merge(other.cToLuaLatency);
+
+		//Functions are merged by name, and kept sorted by total time.
+		std::map<std::string, FunctionStatistics> byName;
+		auto add = [&byName](const std::vector<FunctionStatistics>& list)
+		{
+			for (const FunctionStatistics& f : list)
+			{
+				FunctionStatistics& merged = byName[f.name];
+				merged.name = f.name;
+				merged.calls += f.calls;
+				merged.overloadMisses += f.overloadMisses;
+				merged.latency.merge(f.latency);
+			}
+		};
+
+		add(functions);
+		add(other.functions);
+
+		functions.clear();
+		for (auto& entry : byName)
+		{
+			functions.push_back(entry.second);
+		}
+
+		std::stable_sort(functions.begin(), functions.end(), [](const FunctionStatistics& a, const FunctionStatistics& b)
+		{
+			return a.latency.totalNanoseconds > b.latency.totalNanoseconds;
+		});
+	}
+
+#ifdef LBIND_STATISTICS
+	namespace
+	{
+		std::mutex trackingLock;
+		std::set<Detail::InternalState *> liveStates;
+		Statistics retired;
+
+		Statistics collect(Detail::InternalState * internal)
+		{
+			Statistics result;
+			internal->collectFunctions(result);
+
+			//Merging sorts the functions.
+			Statistics counters = internal->statistics;
+			counters.functions.clear();
+			result.merge(counters);
+
+			return result;
+		}
+	}
+
+	namespace Detail
+	{
+		void trackState(InternalState * state)
+		{
+			std::lock_guard<std::mutex> guard(trackingLock);
+			liveStates.insert(state);
+		}
+
+		void retireState(InternalState * state)
+		{
+			Statistics last = collect(state);
+
+			std::lock_guard<std::mutex> guard(trackingLock);
+			liveStates.erase(state);
+			retired.merge(last);
+		}
+
+		void countConversions(lua_State * state, int first, int count)
+		{
+			Statistics& s = getInternalState(state)->statistics;
+			s.converts += count;
+
+			first = lua_absindex(state, first);
+			for (int i = first; i < first + count; ++i)
+			{
+				if (lua_type(state, i) == LUA_TSTRING)
+				{
+					s.convertedBytes += lua_rawlen(state, i);
+				}
+			}
+		}
+
+		boost::uint64_t now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		LuaCallTimer::LuaCallTimer(lua_State * state, int arguments)
+			:state(state)
+			,start(now())
+		{
+			countConversions(state, -arguments, arguments);
+		}
+
+		LuaCallTimer::~LuaCallTimer()
+		{
+			Statistics& s = getInternalState(state)->statistics;
+			s.cToLua++;
+			s.cToLuaLatency.record(now() - start);
+		}
+
+		void FunctionBase::record(lua_State * state, int results, boost::uint64_t elapsed)
+		{
+			Statistics& s = getInternalState(state)->statistics;
+			s.luaToC++;
+			s.luaToCLatency.record(elapsed);
+
+			statistics.calls++;
+			statistics.latency.record(elapsed);
+
+			if (results < 0)
+			{
+				s.overloadMisses++;
+
+				//Overloads count their misses on the candidates instead.
+				if (!toOverloaded())
+				{
+					statistics.overloadMisses++;
+				}
+			}
+			else
+			{
+				countConversions(state, -results, results);
+			}
+		}
+
+		void InternalState::collectFunctions(Statistics& out) const
+		{
+			for (FunctionBase * f : registeredFunctions)
+			{
+				if (f->statistics.calls || f->statistics.overloadMisses)
+				{
+					out.functions.push_back(f->statistics);
+					out.functions.back().name = f->name;
+				}
+			}
+		}
+
+		void InternalState::resetFunctions()
+		{
+			for (FunctionBase * f : registeredFunctions)
+			{
+				f->statistics = FunctionStatistics();
+			}
+		}
+	}
+
+	Statistics getStatistics(lua_State * state)
+	{
+		if (state)
+		{
+			return collect(Detail::getInternalState(state));
+		}
+
+		std::lock_guard<std::mutex> guard(trackingLock);
+
+		Statistics result = retired;
+		for (Detail::InternalState * s : liveStates)
+		{
+			result.merge(collect(s));
+		}
+
+		return result;
+	}
+
+	void resetStatistics(lua_State * state)
+	{
+		if (state)
+		{
+			Detail::InternalState * internal = Detail::getInternalState(state);
+			internal->statistics = Statistics();
+			internal->resetFunctions();
+			return;
+		}
+
+		std::lock_guard<std::mutex> guard(trackingLock);
+
+		retired = Statistics();
+		for (Detail::InternalState * s : liveStates)
+		{
+			s->statistics = Statistics();
+			s->resetFunctions();
+		}
+	}
+#else
+	Statistics getStatistics(lua_State *)
+	{
+		return Statistics();
+	}
+
+	void resetStatistics(lua_State *)
+	{}
+#endif
+}
@@ -0,0 +1,111 @@
+#include "table_iter.hpp"
+
+namespace lbind
+{
+	namespace Detail
+	{
+		TableEntry::TableEntry(lua_State * state, int key)
+			:interpreter(state)
+			,keyIndex(key)
+		{}
+
+		StackObject TableEntry::key() const
+		{
+			return StackObject(interpreter, keyIndex);
+		}
+
+		StackObject TableEntry::value() const
+		{
+			return StackObject(interpreter, keyIndex + 1);
+		}
+
+		int TableEntry::keyType() const
+		{
+			return lua_type(interpreter, keyIndex);
+		}
+
+		int TableEntry::valueType() const
+		{
+			return lua_type(interpreter, keyIndex + 1);
+		}
+
+		Iterator::Iterator(lua_State * state, int table, int base)
+			:interpreter(state)
+			,table(lua_absindex(state, table))
+			,base(base)
+			,keyIndex(0)
+			,active(true)
+		{
+			//[..., nil]
+			lua_pushnil(interpreter);
+			keyIndex = lua_gettop(interpreter);
+
+			next();
+		}
+
+		Iterator::Iterator()
+			:interpreter(nullptr)
+			,table(0)
+			,base(0)
+			,keyIndex(0)
+			,active(false)
+		{}
+
+		Iterator::Iterator(Iterator&& other)
+			:interpreter(other.interpreter)
+			,table(other.table)
+			,base(other.base)
+			,keyIndex(other.keyIndex)
+			,active(other.active)
+		{
+			other.active = false;
+		}
+
+		Iterator::~Iterator()
+		{
+			finish();
+		}
+
+		Iterator& Iterator::operator++()
+		{
+			//Pop the value, lua_next needs the key.
+			lua_pop(interpreter, 1);
+			next();
+
+			return *this;
+		}
+
+		TableEntry Iterator::operator*() const
+		{
+			return TableEntry(interpreter, keyIndex);
+		}
+
+		bool Iterator::operator==(const Iterator& other) const
+		{
+			return active == other.active;
+		}
+
+		bool Iterator::operator!=(const Iterator& other) const
+		{
+			return !(*this == other);
+		}
+
+		void Iterator::next()
+		{
+			//Stack is [..., key], and becomes [..., key, value] or [...] on the last entry.
+			if (!lua_next(interpreter, table))
+			{
+				finish();
+			}
+		}
+
+		void Iterator::finish()
+		{
+			if (active)
+			{
+				lua_settop(interpreter, base);
+				active = false;
+			}
+		}
+	}
+}
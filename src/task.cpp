@@ -0,0 +1,111 @@
+#include "task.hpp"
+
+namespace lbind
+{
+	namespace Detail
+	{
+		LuaCoroutine::~LuaCoroutine()
+		{
+			if (done)
+			{
+				return;
+			}
+
+			//Suspended on an Async, it can only be left to finish. Otherwise nothing would ever
+			//resume it again.
+			if (running)
+			{
+				loop.detach(thread, this);
+			}
+			else
+			{
+				loop.release(thread, this);
+			}
+		}
+
+		bool LuaCoroutine::resume(std::coroutine_handle<> waiting)
+		{
+			int pushed = started ? 0 : arguments;
+			started = true;
+			running = true;
+
+			loop.resume(thread, pushed);
+			if (!running)
+			{
+				return false;
+			}
+
+			awaiting = waiting;
+			return true;
+		}
+
+		void LuaCoroutine::rethrow()
+		{
+			if (error)
+			{
+				std::exception_ptr raised = error;
+				error = nullptr;
+				std::rethrow_exception(raised);
+			}
+		}
+
+		bool LuaCoroutine::yielded(lua_State * from, int results)
+		{
+			if (!generator)
+			{
+				return false;
+			}
+
+			//Handed to whoever awaits the value, rather than thrown from the loop.
+			try
+			{
+				take(from, results);
+			}
+			catch (const BadCast&)
+			{
+				error = std::current_exception();
+			}
+
+			wake();
+			return true;
+		}
+
+		void LuaCoroutine::finished(lua_State * from, int results, const std::string * raised)
+		{
+			done = true;
+
+			if (raised)
+			{
+				error = std::make_exception_ptr(LuaError(raised->c_str()));
+			}
+			else if (!generator)
+			{
+				try
+				{
+					take(from, results);
+				}
+				catch (const BadCast&)
+				{
+					error = std::current_exception();
+				}
+			}
+
+			wake();
+		}
+
+		void LuaCoroutine::wake()
+		{
+			running = false;
+
+			//Resumed from the loop rather than here, where the loop is still in lua_resume.
+			if (awaiting)
+			{
+				std::coroutine_handle<> resumed = awaiting;
+				awaiting = nullptr;
+				loop.post([resumed]() {
+					resumed.resume();
+				});
+			}
+		}
+	}
+}
@@ -0,0 +1,161 @@
+#include "allocations.hpp"
+
+#ifdef LBIND_COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace
+{
+	thread_local size_t cppAllocations = 0;
+	thread_local size_t luaAllocations = 0;
+
+	void * allocate(size_t bytes)
+	{
+		cppAllocations++;
+
+		void * result = std::malloc(bytes ? bytes : 1);
+		if (!result)
+		{
+			throw std::bad_alloc();
+		}
+
+		return result;
+	}
+
+	void * allocateAligned(size_t bytes, std::align_val_t alignment)
+	{
+		cppAllocations++;
+
+		void * result = nullptr;
+		if (posix_memalign(&result, static_cast<size_t>(alignment), bytes ? bytes : 1) != 0)
+		{
+			throw std::bad_alloc();
+		}
+
+		return result;
+	}
+
+	//The allocator a state had before it was wrapped. States made by luaL_newstate all share
+	//one, so these are kept per allocator rather than per state, and live until exit.
+	typedef std::pair<lua_Alloc, void *> Allocator;
+
+	void * countingAlloc(void * ud, void * ptr, size_t osize, size_t nsize)
+	{
+		const Allocator * original = static_cast<const Allocator *>(ud);
+
+		//Growing a block in place still counts: it is a call into the allocator that may move.
+		if (nsize > 0 && (!ptr || nsize > osize))
+		{
+			luaAllocations++;
+		}
+
+		return original->first(original->second, ptr, osize, nsize);
+	}
+}
+
+void * operator new(size_t bytes)
+{
+	return allocate(bytes);
+}
+
+void * operator new[](size_t bytes)
+{
+	return allocate(bytes);
+}
+
+void * operator new(size_t bytes, const std::nothrow_t&) noexcept
+{
+	cppAllocations++;
+	return std::malloc(bytes ? bytes : 1);
+}
+
+void * operator new[](size_t bytes, const std::nothrow_t&) noexcept
+{
+	cppAllocations++;
+	return std::malloc(bytes ? bytes : 1);
+}
+
+void * operator new(size_t bytes, std::align_val_t alignment)
+{
+	return allocateAligned(bytes, alignment);
+}
+
+void * operator new[](size_t bytes, std::align_val_t alignment)
+{
+	return allocateAligned(bytes, alignment);
+}
+
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete[](void * p) noexcept { std::free(p); }
+void operator delete(void * p, size_t) noexcept { std::free(p); }
+void operator delete[](void * p, size_t) noexcept { std::free(p); }
+void operator delete(void * p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void * p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void * p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void * p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void * p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void * p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+AllocationCounter::AllocationCounter()
+	:start(AllocationCounts{ cppAllocations, luaAllocations })
+{}
+
+AllocationCounts AllocationCounter::counts() const
+{
+	return AllocationCounts{ cppAllocations - start.cpp, luaAllocations - start.lua };
+}
+
+size_t AllocationCounter::count() const
+{
+	return counts().total();
+}
+
+bool countingAllocations()
+{
+	return true;
+}
+
+void countLuaAllocations(lua_State * state)
+{
+	static std::mutex lock;
+	static std::map<Allocator, Allocator> allocators;
+
+	void * ud = nullptr;
+	lua_Alloc f = lua_getallocf(state, &ud);
+	if (f == countingAlloc)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	Allocator& original = allocators[Allocator(f, ud)];
+	original = Allocator(f, ud);
+
+	lua_setallocf(state, countingAlloc, &original);
+}
+#else
+AllocationCounter::AllocationCounter()
+	:start(AllocationCounts{ 0, 0 })
+{}
+
+AllocationCounts AllocationCounter::counts() const
+{
+	return start;
+}
+
+size_t AllocationCounter::count() const
+{
+	return 0;
+}
+
+bool countingAllocations()
+{
+	return false;
+}
+
+void countLuaAllocations(lua_State *)
+{}
+#endif
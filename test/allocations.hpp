@@ -0,0 +1,67 @@
+#pragma once
+#include <lua.hpp>
+
+#include <cstddef>
+
+/*
+	Allocation counting for tests and benchmarks, enabled by building with LBIND_COUNT_ALLOCATIONS.
+
+	Global operator new is replaced to count C++ allocations, and states passed to
+	countLuaAllocations have their allocator wrapped to count what Lua allocates. malloc itself
+	is not interposed, so allocations made by C code other than Lua are not seen.
+
+		LBIND_EXPECT_ALLOCS(0, call<int>(add, 1, 2));
+
+	runs the statement once to warm caches and the Lua stack, then again while counting, and
+	checks the count. Without LBIND_COUNT_ALLOCATIONS the statement still runs twice, but nothing
+	is checked.
+
+	Counts are per thread.
+*/
+struct AllocationCounts
+{
+	size_t cpp;
+	size_t lua;
+
+	size_t total() const
+	{
+		return cpp + lua;
+	}
+};
+
+//Counts allocations made on this thread since the counter was created.
+class AllocationCounter
+{
+public:
+	AllocationCounter();
+
+	AllocationCounts counts() const;
+	size_t count() const;
+private:
+	AllocationCounts start;
+};
+
+bool countingAllocations();
+
+//Only counts from now on; a no-op without LBIND_COUNT_ALLOCATIONS.
+void countLuaAllocations(lua_State * state);
+
+#ifdef LBIND_COUNT_ALLOCATIONS
+	#define LBIND_EXPECT_ALLOCS(expected, ...) \
+		do \
+		{ \
+			{ __VA_ARGS__; } \
+			AllocationCounter lbindAllocations; \
+			{ __VA_ARGS__; } \
+			AllocationCounts lbindCounts = lbindAllocations.counts(); \
+			BOOST_CHECK_MESSAGE(lbindCounts.total() == static_cast<size_t>(expected), \
+				"expected " << (expected) << " allocations in " #__VA_ARGS__ ", got " << lbindCounts.cpp << " C++ and " << lbindCounts.lua << " Lua"); \
+		} while (0)
+#else
+	#define LBIND_EXPECT_ALLOCS(expected, ...) \
+		do \
+		{ \
+			{ __VA_ARGS__; } \
+			{ __VA_ARGS__; } \
+		} while (0)
+#endif
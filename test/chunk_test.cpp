@@ -0,0 +1,192 @@
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include "fixtures.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	struct CacheDirectory
+	{
+		CacheDirectory()
+			:path((std::filesystem::temp_directory_path() / "lbind_chunk_test").string())
+		{
+			std::filesystem::remove_all(path);
+		}
+
+		~CacheDirectory()
+		{
+			std::filesystem::remove_all(path);
+		}
+
+		std::string path;
+	};
+}
+
+BOOST_AUTO_TEST_CASE(chunk_cache_reuses_functions)
+{
+	using namespace lbind;
+	StateFixture f;
+	ChunkCache cache;
+
+	const char * script = "counter = (counter or 0) + 1; return counter";
+
+	int top = lua_gettop(f.state);
+	Object first = cache.load(f.state, script, "=counter");
+	Object second = cache.load(f.state, script, "=counter");
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+
+	BOOST_CHECK_EQUAL(call<int>(first), 1);
+	BOOST_CHECK_EQUAL(call<int>(second), 2);
+
+	ChunkCache::Counters c = cache.counters();
+	BOOST_CHECK_EQUAL(c.compiles, 1);
+	BOOST_CHECK_EQUAL(c.stateHits, 1);
+
+	//Other states reuse the bytecode.
+	StateFixture other;
+	Object third = cache.load(other.state, script, "=counter");
+	BOOST_CHECK_EQUAL(call<int>(third), 1);
+	BOOST_CHECK_EQUAL(cache.counters().memoryHits, 1);
+
+	//The name is part of the key.
+	cache.load(f.state, script, "=other");
+	BOOST_CHECK_EQUAL(cache.counters().compiles, 2);
+}
+
+BOOST_AUTO_TEST_CASE(chunk_cache_syntax_errors)
+{
+	using namespace lbind;
+	StateFixture f;
+	ChunkCache cache;
+
+	int top = lua_gettop(f.state);
+	BOOST_CHECK_THROW(cache.load(f.state, "return +", "=broken"), LuaError);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+BOOST_AUTO_TEST_CASE(chunk_cache_persists_bytecode)
+{
+	using namespace lbind;
+	CacheDirectory directory;
+
+	const char * script = "return 40 + 2";
+	{
+		StateFixture f;
+		ChunkCache cache(directory.path);
+		BOOST_CHECK_EQUAL(call<int>(cache.load(f.state, script, "=answer")), 42);
+		BOOST_CHECK_EQUAL(cache.counters().compiles, 1);
+	}
+
+	//A new cache, as in a restarted process, finds the file.
+	{
+		StateFixture f;
+		ChunkCache cache(directory.path);
+		BOOST_CHECK_EQUAL(call<int>(cache.load(f.state, script, "=answer")), 42);
+		BOOST_CHECK_EQUAL(cache.counters().diskHits, 1);
+		BOOST_CHECK_EQUAL(cache.counters().compiles, 0);
+	}
+
+	//Corrupt files are recompiled instead of loaded.
+	for (auto& entry : std::filesystem::directory_iterator(directory.path))
+	{
+		std::filesystem::resize_file(entry.path(), 10);
+	}
+
+	{
+		StateFixture f;
+		ChunkCache cache(directory.path);
+		BOOST_CHECK_EQUAL(call<int>(cache.load(f.state, script, "=answer")), 42);
+		BOOST_CHECK_EQUAL(cache.counters().diskHits, 0);
+		BOOST_CHECK_EQUAL(cache.counters().compiles, 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(bundle_round_trip)
+{
+	using namespace lbind;
+	CacheDirectory directory;
+	std::filesystem::create_directories(directory.path);
+	std::string path = directory.path + "/scripts.lbb";
+
+	BundleWriter writer;
+	writer.add("util.math", "local M = {} function M.double(x) return x * 2 end return M");
+	writer.add("answer", "return require('util.math').double(21)");
+	writer.add("broken", "error('from bundle')");
+	BOOST_CHECK_THROW(writer.add("invalid", "return +"), LuaError);
+	writer.write(path);
+
+	Bundle bundle(path);
+	BOOST_CHECK_EQUAL(bundle.size(), 3);
+	BOOST_CHECK(bundle.contains("answer"));
+	BOOST_CHECK(!bundle.contains("invalid"));
+
+	StateFixture f;
+	bundle.install(f.state);
+
+	BOOST_CHECK_EQUAL(call<int>(bundle.load(f.state, "answer")), 42);
+	BOOST_CHECK_THROW(bundle.load(f.state, "missing"), LuaError);
+
+	BOOST_CHECK(!dostring(f.state, "m = require('util.math'); v = require('answer')"));
+
+	int v = globals(f.state)["v"];
+	BOOST_CHECK_EQUAL(v, 42);
+
+	//Errors keep the module name as the chunk name.
+	const char * error = dostring(f.state, "require('broken')");
+	BOOST_REQUIRE(error);
+	BOOST_CHECK(std::string(error).find("broken:1:") != std::string::npos);
+
+	//Names missing from the bundle fall through to the other searchers.
+	error = dostring(f.state, "require('not.there')");
+	BOOST_REQUIRE(error);
+	BOOST_CHECK(std::string(error).find("no module 'not.there' in bundle") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(bundle_rejects_other_files)
+{
+	using namespace lbind;
+	CacheDirectory directory;
+	std::filesystem::create_directories(directory.path);
+
+	std::string path = directory.path + "/garbage.lbb";
+	std::ofstream(path) << "this is not a bundle at all";
+
+	BOOST_CHECK_THROW(Bundle bundle(path), BindingError);
+	BOOST_CHECK_THROW(Bundle bundle(directory.path + "/missing.lbb"), BindingError);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_compilation)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	std::vector<Script> scripts;
+	for (int i = 0; i < 32; ++i)
+	{
+		scripts.push_back(Script{ "=script" + std::to_string(i), "return " + std::to_string(i) + " * 2" });
+	}
+
+	scripts[7].source = "return +";
+
+	int top = lua_gettop(f.state);
+	std::vector<CompileResult> results = compileParallel(f.state, scripts, 4);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+
+	BOOST_REQUIRE_EQUAL(results.size(), scripts.size());
+	for (int i = 0; i < 32; ++i)
+	{
+		if (i == 7)
+		{
+			BOOST_CHECK(!results[i].ok());
+			BOOST_CHECK(results[i].error.find("script7:1:") != std::string::npos);
+			continue;
+		}
+
+		BOOST_REQUIRE(results[i].ok());
+		BOOST_CHECK_EQUAL(call<int>(results[i].function), i * 2);
+	}
+
+	BOOST_CHECK(compileParallel(f.state, {}).empty());
+}
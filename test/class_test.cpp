@@ -121,6 +121,41 @@ namespace
 	};
 
 
+	struct Buffer
+	{
+		static int live;
+		static int peak;
+
+		explicit Buffer(int kilobytes)
+			:bytes(static_cast<size_t>(kilobytes) * 1024)
+		{
+			live++;
+			peak = std::max(peak, live);
+		}
+
+		Buffer(const Buffer& other)
+			:bytes(other.bytes)
+		{
+			live++;
+			peak = std::max(peak, live);
+		}
+
+		~Buffer()
+		{
+			live--;
+		}
+
+		static size_t size(const Buffer& b)
+		{
+			return sizeof(Buffer) + b.bytes.size();
+		}
+
+		std::vector<char> bytes;
+	};
+
+	int Buffer::live;
+	int Buffer::peak;
+
 	template<typename T>
 	void external_add(Storage<T> * val, int n)
 	{
@@ -425,3 +460,110 @@ BOOST_AUTO_TEST_CASE(multiple_constructors)
 	BOOST_CHECK_EQUAL(store2.a, 2);
 	BOOST_CHECK_EQUAL(store3.a, 4);
 }
+
+BOOST_AUTO_TEST_CASE(external_memory_bounds_garbage)
+{
+	Buffer::live = 0;
+	Buffer::peak = 0;
+
+	{
+		StateFixture f;
+		module(f.state)
+			.class_<Buffer>("Buffer")
+				.constructor<int>()
+				.size(&Buffer::size)
+			.endclass()
+		.end();
+
+		//Each buffer is a megabyte behind 8 bytes of userdata. Without reporting that to the
+		//collector, hundreds pile up before a cycle finishes.
+		std::string script = "for i = 1, 500 do local b = Buffer(1024) end";
+		BOOST_CHECK(!dostring(f, script));
+		BOOST_CHECK_LT(Buffer::peak, 64);
+
+		BOOST_CHECK(!dostring(f, "kept = Buffer(4)"));
+		lua_gc(f.state, LUA_GCCOLLECT, 0);
+
+		BOOST_CHECK_EQUAL(Buffer::live, 1);
+		BOOST_CHECK_EQUAL(externalMemory(f.state), sizeof(Buffer) + 4 * 1024);
+	}
+
+	BOOST_CHECK_EQUAL(Buffer::live, 0);
+}
+
+BOOST_AUTO_TEST_CASE(primitive_properties_do_not_allocate)
+{
+	StateFixture f;
+	module(f.state)
+		.class_<Storage<int>>("Int")
+			.constructor<int>()
+			.def_readwrite("value", &Storage<int>::stored)
+			.def("add", &Storage<int>::add)
+		.endclass()
+	.end();
+
+	BOOST_CHECK(!dostring(f, "a = Int(0)"));
+
+	Object read = compile(f.state, "local x = 0 for i = 1, 100 do x = x + a.value end");
+	Object write = compile(f.state, "for i = 1, 100 do a.value = i end");
+	Object method = compile(f.state, "for i = 1, 100 do a:add(1) end");
+
+	LBIND_EXPECT_ALLOCS(0, call<void>(read));
+	LBIND_EXPECT_ALLOCS(0, call<void>(write));
+	LBIND_EXPECT_ALLOCS(0, call<void>(method));
+}
+
+BOOST_AUTO_TEST_CASE(registering_classes_leaves_stack_balanced)
+{
+	StateFixture f;
+	int top = lua_gettop(f.state);
+
+	module(f.state)
+		.class_<Storage<short>>("Short")
+			.constructor<short>()
+		.endclass()
+		.class_<Storage<long>>("Long")
+			.constructor<long>()
+		.endclass()
+		.scope("ns")
+			.class_<Storage<float>>("Float")
+				.constructor<float>()
+			.endclass()
+		.endscope()
+	.end();
+
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+	BOOST_CHECK(!dostring(f, "a = Short(1) b = Long(2) c = ns.Float(3)"));
+}
+
+BOOST_AUTO_TEST_CASE(lua_function_class_results)
+{
+	StateFixture f;
+	module(f.state)
+		.class_<Storage<int>>("Int")
+			.constructor<int>()
+		.endclass()
+	.end();
+
+	BOOST_CHECK(!dostring(f, "function make() return Int(3) end function none() return nil end function table() return {} end"));
+
+	Object g = globals(f.state);
+	LuaFunction<Storage<int> *()> make(g["make"]);
+	BOOST_CHECK_EQUAL(make()->stored, 3);
+
+	int top = lua_gettop(f.state);
+	LuaFunction<Storage<int> *()> none(g["none"]);
+	LuaFunction<Storage<int> *()> table(g["table"]);
+	LuaFunction<Storage<int>()> noneValue(g["none"]);
+	BOOST_CHECK_THROW(none(), BadCast);
+	BOOST_CHECK_THROW(table(), BadCast);
+	BOOST_CHECK_THROW(noneValue(), BadCast);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+
+	//Anything converts to an Object.
+	LuaFunction<Object()> tableObject(g["table"]);
+	LuaFunction<Object()> noneObject(g["none"]);
+	BOOST_CHECK_EQUAL(tableObject().type(), LUA_TTABLE);
+	BOOST_CHECK_EQUAL(noneObject().type(), LUA_TNIL);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
@@ -0,0 +1,220 @@
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include "fixtures.hpp"
+#include "binddsl.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	lbind::EventLoop * running = nullptr;
+	std::vector<lbind::Async<int>> requests;
+
+	//Completed later, by the test.
+	lbind::Async<int> fetch(int)
+	{
+		lbind::Async<int> result;
+		requests.push_back(result);
+		return result;
+	}
+
+	lbind::Async<int> ready(int n)
+	{
+		lbind::Async<int> result;
+		result.resolve(n);
+		return result;
+	}
+
+	lbind::Async<std::string> failing()
+	{
+		lbind::Async<std::string> result;
+		result.reject("no such file");
+		return result;
+	}
+
+	lbind::Async<void> sleep(int ms)
+	{
+		lbind::Async<void> done;
+		running->after(std::chrono::milliseconds(ms), [done]() { done.resolve(); });
+		return done;
+	}
+
+	void bind(lua_State * state)
+	{
+		using namespace lbind;
+
+		module(state)
+			.def("fetch", fetch)
+			.def("ready", ready)
+			.def("failing", failing)
+			.def("sleep", sleep)
+		.end();
+	}
+
+	struct LoopFixture : StateFixture
+	{
+		LoopFixture()
+			:loop(state)
+		{
+			bind(state);
+			requests.clear();
+			running = &loop;
+		}
+
+		~LoopFixture()
+		{
+			running = nullptr;
+			requests.clear();
+		}
+
+		lbind::Object global(const char * name)
+		{
+			return lbind::globals(state)[name];
+		}
+
+		lbind::EventLoop loop;
+	};
+}
+
+BOOST_FIXTURE_TEST_CASE(async_resumes_coroutine_with_value, LoopFixture)
+{
+	BOOST_REQUIRE(!dostring(state, "function handler(n) result = fetch(n) + 1 end"));
+
+	loop.spawn(global("handler"), 1);
+	BOOST_CHECK_EQUAL(loop.coroutines(), 1);
+	BOOST_REQUIRE_EQUAL(requests.size(), 1);
+
+	//Completed from another thread, as I/O would be.
+	std::thread producer([]() { requests[0].resolve(41); });
+	loop.run();
+	producer.join();
+
+	BOOST_CHECK_EQUAL(loop.coroutines(), 0);
+	BOOST_CHECK_EQUAL(lbind::cast<int>(global("result")), 42);
+}
+
+BOOST_FIXTURE_TEST_CASE(completed_async_does_not_yield, LoopFixture)
+{
+	//Outside of a coroutine too.
+	BOOST_CHECK(!dostring(state, "x = ready(5)"));
+	BOOST_CHECK_EQUAL(lbind::cast<int>(global("x")), 5);
+}
+
+BOOST_FIXTURE_TEST_CASE(rejected_async_raises_in_coroutine, LoopFixture)
+{
+	BOOST_REQUIRE(!dostring(state,
+		"function caught() ok, message = pcall(failing) end "
+		"function uncaught() failing() end"));
+
+	loop.spawn(global("caught"));
+	loop.run();
+	BOOST_CHECK(!lbind::cast<bool>(global("ok")));
+	BOOST_CHECK(std::strstr(lbind::cast<const char *>(global("message")), "no such file"));
+
+	loop.spawn(global("uncaught"));
+	BOOST_CHECK_THROW(loop.run(), lbind::LuaError);
+	BOOST_CHECK_EQUAL(loop.coroutines(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(timers_resume_coroutines_in_deadline_order, LoopFixture)
+{
+	BOOST_REQUIRE(!dostring(state,
+		"order = '' "
+		"function wait(ms, name) sleep(ms) order = order .. name end"));
+
+	auto begin = std::chrono::steady_clock::now();
+	loop.spawn(global("wait"), 30, std::string("c"));
+	loop.spawn(global("wait"), 1, std::string("a"));
+	loop.spawn(global("wait"), 15, std::string("b"));
+	BOOST_CHECK_EQUAL(loop.coroutines(), 3);
+
+	loop.run();
+	BOOST_CHECK_EQUAL(lbind::cast<std::string>(global("order")), "abc");
+	BOOST_CHECK(std::chrono::steady_clock::now() - begin >= std::chrono::milliseconds(30));
+}
+
+BOOST_FIXTURE_TEST_CASE(yielding_coroutines_resume_next_turn, LoopFixture)
+{
+	BOOST_REQUIRE(!dostring(state,
+		"steps = 0 "
+		"function step() for i = 1, 3 do steps = steps + 1 coroutine.yield() end end"));
+
+	loop.spawn(global("step"));
+	BOOST_CHECK_EQUAL(lbind::cast<int>(global("steps")), 1);
+
+	loop.poll();
+	BOOST_CHECK_EQUAL(lbind::cast<int>(global("steps")), 2);
+
+	loop.run();
+	BOOST_CHECK_EQUAL(lbind::cast<int>(global("steps")), 3);
+	BOOST_CHECK_EQUAL(loop.coroutines(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(async_rejects_misuse, LoopFixture)
+{
+	//Not in a coroutine.
+	const char * error = dostring(state, "fetch(1)");
+	BOOST_REQUIRE(error);
+	BOOST_CHECK(std::strstr(error, "coroutine"));
+	lua_pop(state, 1);
+
+	//In one the loop did not start.
+	error = dostring(state, "return coroutine.wrap(function() return fetch(1) end)()");
+	BOOST_REQUIRE(error);
+	BOOST_CHECK(std::strstr(error, "EventLoop::spawn"));
+	lua_pop(state, 1);
+
+	BOOST_CHECK_THROW(lbind::EventLoop second(state), lbind::BindingError);
+
+	//Passed to Lua from C++ rather than returned by a binding, where it would suspend the next
+	//bound call instead.
+	BOOST_REQUIRE(!dostring(state, "function identity(x) return x end"));
+	lbind::LuaFunction<void(lbind::Async<int>)> identity(global("identity"));
+	int top = lua_gettop(state);
+	BOOST_CHECK_THROW(identity(lbind::Async<int>()), lbind::BadCast);
+	BOOST_CHECK(!lbind::Detail::getInternalState(state)->suspending);
+
+	//A batch stops at the argument, and leaves the stack as it found it.
+	std::vector<std::tuple<lbind::Async<int>>> pending(2);
+	BOOST_CHECK_THROW(lbind::callBatch(identity, pending.data(), pending.size()), lbind::BadCast);
+	BOOST_CHECK_EQUAL(lua_gettop(state), top);
+
+	BOOST_CHECK(!dostring(state, "x = ready(7)"));
+	BOOST_CHECK_EQUAL(lbind::cast<int>(global("x")), 7);
+}
+
+BOOST_AUTO_TEST_CASE(event_loop_abandons_pending_asyncs)
+{
+	StateFixture f;
+	bind(f.state);
+	requests.clear();
+
+	{
+		lbind::EventLoop loop(f.state);
+		BOOST_REQUIRE(!dostring(f, "function handler() fetch(1) end"));
+		loop.spawn(lbind::globals(f.state)["handler"]);
+		BOOST_CHECK_EQUAL(loop.coroutines(), 1);
+	}
+
+	//Nothing is waiting any more.
+	requests[0].resolve(1);
+	requests.clear();
+
+	//And another loop can take over.
+	lbind::EventLoop next(f.state);
+	BOOST_CHECK_EQUAL(next.coroutines(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(event_loop_outlives_close)
+{
+	StateFixture f;
+	{
+		lbind::EventLoop loop(f.state);
+		lbind::close(f.state);
+	}
+
+	BOOST_CHECK(!lbind::Detail::getInternalState(f.state));
+}
@@ -0,0 +1,113 @@
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include "fixtures.hpp"
+
+namespace
+{
+	struct PoolFixture : StateFixture
+	{
+		PoolFixture()
+		{
+			BOOST_REQUIRE(!dostring(state,
+				"function add(a, b) return a + b end "
+				"function broken() error('boom') end "
+				"function paused() coroutine.yield(1) return 2 end "
+				"function deep(n) if n == 0 then return 0 end return 1 + deep(n - 1) end"));
+		}
+
+		lbind::Object global(const char * name)
+		{
+			return lbind::globals(state)[name];
+		}
+	};
+}
+
+BOOST_FIXTURE_TEST_CASE(coroutine_pool_reuses_finished_coroutines, PoolFixture)
+{
+	using namespace lbind;
+
+	CoroutinePool pool(state);
+	lua_State * first = nullptr;
+	{
+		PooledCoroutine co = pool.acquire();
+		first = co.get();
+
+		BOOST_CHECK_EQUAL(co.start(global("add"), 1, 2), LUA_OK);
+		BOOST_CHECK_EQUAL(co.results(), 1);
+		BOOST_CHECK_EQUAL(indexCast<int>(co.get(), -1), 3);
+	}
+
+	BOOST_CHECK_EQUAL(pool.idle(), 1);
+
+	PooledCoroutine again = pool.acquire();
+	BOOST_CHECK_EQUAL(again.get(), first);
+	BOOST_CHECK_EQUAL(lua_gettop(again.get()), 0);
+	BOOST_CHECK_EQUAL(pool.created(), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(coroutine_pool_resets_failed_and_suspended_coroutines, PoolFixture)
+{
+	using namespace lbind;
+
+	CoroutinePool pool(state);
+	{
+		PooledCoroutine co = pool.acquire();
+		BOOST_CHECK(co.start(global("broken")) != LUA_OK);
+	}
+
+	{
+		PooledCoroutine co = pool.acquire();
+		BOOST_CHECK_EQUAL(lua_status(co.get()), LUA_OK);
+		BOOST_CHECK_EQUAL(co.start(global("paused")), LUA_YIELD);
+		BOOST_CHECK_EQUAL(indexCast<int>(co.get(), -1), 1);
+	}
+
+	PooledCoroutine co = pool.acquire();
+	BOOST_CHECK_EQUAL(lua_status(co.get()), LUA_OK);
+	BOOST_CHECK_EQUAL(co.start(global("add"), 2, 3), LUA_OK);
+	BOOST_CHECK_EQUAL(indexCast<int>(co.get(), -1), 5);
+	BOOST_CHECK_EQUAL(pool.created(), 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(coroutine_pool_keeps_up_to_capacity, PoolFixture)
+{
+	using namespace lbind;
+
+	CoroutinePoolOptions options;
+	options.capacity = 2;
+	options.prewarm = 2;
+
+	CoroutinePool pool(state, options);
+	BOOST_CHECK_EQUAL(pool.idle(), 2);
+
+	{
+		PooledCoroutine a = pool.acquire();
+		PooledCoroutine b = pool.acquire();
+		PooledCoroutine c = pool.acquire();
+		BOOST_CHECK_EQUAL(pool.idle(), 0);
+		BOOST_CHECK_EQUAL(pool.created(), 3);
+
+		//Given back early, and the handle left empty.
+		a.release();
+		BOOST_CHECK(!a.get());
+		BOOST_CHECK_EQUAL(pool.idle(), 1);
+	}
+
+	BOOST_CHECK_EQUAL(pool.idle(), 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(coroutine_pool_starts_without_allocating, PoolFixture)
+{
+	using namespace lbind;
+
+	CoroutinePoolOptions options;
+	options.stackDepth = 1024;
+
+	CoroutinePool pool(state, options);
+	Object deep = global("deep");
+
+	LBIND_EXPECT_ALLOCS(0, {
+		PooledCoroutine co = pool.acquire();
+		BOOST_CHECK_EQUAL(co.start(deep, 50), LUA_OK);
+	});
+}
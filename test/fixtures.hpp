@@ -1,5 +1,6 @@
 #pragma once
 #include "lbind.hpp"
+#include "allocations.hpp"
 #include <boost/test/unit_test.hpp>
 
 struct StateFixture
@@ -7,6 +8,7 @@ struct StateFixture
 	inline StateFixture()
 	{
 		state = luaL_newstate();
+		countLuaAllocations(state);
 
 		lbind::open(state);
 		luaL_openlibs(state);
@@ -3,6 +3,9 @@
 #include <boost/lexical_cast.hpp>
 #include "fixtures.hpp"
 
+#include <map>
+#include <sstream>
+
 namespace
 {
 	boost::int64_t addone(boost::int64_t a)
@@ -285,6 +288,326 @@ BOOST_AUTO_TEST_CASE(string_to_integer_conversion_is_implicit)
 
 	BOOST_CHECK_EQUAL(res, 3);
 }
+
+BOOST_AUTO_TEST_CASE(typed_lua_function)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	BOOST_CHECK(!dostring(f.state, "function add(a, b) return a + b end function greet(name) return 'hi ' .. name end"));
+
+	LuaFunction<int(int, int)> add(globals(f.state)["add"]);
+	LuaFunction<std::string(const std::string&)> greet(globals(f.state)["greet"]);
+
+	int top = lua_gettop(f.state);
+	BOOST_CHECK_EQUAL(add(1, 2), 3);
+	BOOST_CHECK_EQUAL(add(40, 2), 42);
+	BOOST_CHECK_EQUAL(greet("bob"), "hi bob");
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+
+	BOOST_CHECK_THROW(LuaFunction<void()>(globals(f.state)["missing"]), BindingError);
+	BOOST_CHECK_THROW(LuaFunction<void()>()(), BindingError);
+}
+
+BOOST_AUTO_TEST_CASE(typed_lua_function_errors)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	BOOST_CHECK(!dostring(f.state, "function fail(n) error('bad ' .. n, 0) end"));
+
+	LuaFunction<void(int)> fail(globals(f.state)["fail"]);
+
+	int top = lua_gettop(f.state);
+	try
+	{
+		fail(3);
+		BOOST_CHECK(false);
+	}
+	catch (const LuaError& e)
+	{
+		BOOST_CHECK_EQUAL(std::string(e.what()), "bad 3");
+	}
+
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+BOOST_AUTO_TEST_CASE(typed_lua_function_bad_results)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	BOOST_CHECK(!dostring(f.state, "function word() return 'abc' end function echo(x) return x end"));
+
+	LuaFunction<int()> word(globals(f.state)["word"]);
+	LuaFunction<int(Object)> echo(globals(f.state)["echo"]);
+
+	int top = lua_gettop(f.state);
+	BOOST_CHECK_THROW(word(), BadCast);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+
+	//Batches report it as a failed call.
+	std::vector<std::tuple<Object>> args = { std::make_tuple(Object(globals(f.state)["word"])) };
+	std::vector<int> results;
+	BatchResult r = callBatch(echo, args, results);
+	BOOST_CHECK_EQUAL(r.errors.size(), 1);
+	BOOST_CHECK(results.empty());
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+BOOST_AUTO_TEST_CASE(lua_function_as_callback)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	int total = 0;
+	registerFunction(f.state, LUA_RIDX_GLOBALS, "each", [&total](LuaFunction<int(int)> fn)
+	{
+		for (int i = 1; i <= 3; ++i)
+		{
+			total += fn(i);
+		}
+	});
+
+	BOOST_CHECK(!dostring(f.state, "each(function(i) return i * 10 end)"));
+	BOOST_CHECK_EQUAL(total, 60);
+
+	//Anything other than a function does not match.
+	BOOST_CHECK(dostring(f.state, "each(5)"));
+}
+
+BOOST_AUTO_TEST_CASE(lua_function_outlives_coroutine)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	LuaFunction<int(int)> kept;
+	registerFunction(f.state, LUA_RIDX_GLOBALS, "keep", [&kept](LuaFunction<int(int)> fn)
+	{
+		kept = fn;
+	});
+
+	BOOST_CHECK(!dostring(f.state,
+		"local co = coroutine.create(function() keep(function(i) return i + 1 end) coroutine.yield() end) "
+		"coroutine.resume(co) "));
+
+	//The coroutine it was converted in is suspended, and then gone.
+	BOOST_CHECK_EQUAL(kept(1), 2);
+	lua_gc(f.state, LUA_GCCOLLECT);
+	BOOST_CHECK_EQUAL(kept(2), 3);
+	BOOST_CHECK(kept.object().state() == f.state);
+}
+
+BOOST_AUTO_TEST_CASE(batched_lua_calls)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	BOOST_CHECK(!dostring(f.state, "function add(a, b) return a + b end"));
+	LuaFunction<int(int, int)> add(globals(f.state)["add"]);
+
+	std::vector<std::tuple<int, int>> args;
+	for (int i = 0; i < 100; ++i)
+	{
+		args.emplace_back(i, 1);
+	}
+
+	int top = lua_gettop(f.state);
+
+	std::vector<int> results;
+	BatchResult r = callBatch(add, args, results);
+
+	BOOST_CHECK(r.ok());
+	BOOST_CHECK_EQUAL(r.calls, 100);
+	BOOST_REQUIRE_EQUAL(results.size(), 100);
+	BOOST_CHECK_EQUAL(results[0], 1);
+	BOOST_CHECK_EQUAL(results[99], 100);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+BOOST_AUTO_TEST_CASE(batched_lua_calls_errors)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	BOOST_CHECK(!dostring(f.state, "seen = 0; function handle(n) if n % 2 == 1 then error('odd', 0) end seen = seen + 1 end"));
+	LuaFunction<void(int)> handle(globals(f.state)["handle"]);
+
+	std::vector<std::tuple<int>> args = { 0, 1, 2, 3, 4 };
+	int top = lua_gettop(f.state);
+
+	BatchResult stopped = callBatch(handle, args);
+	BOOST_CHECK_EQUAL(stopped.calls, 2);
+	BOOST_REQUIRE_EQUAL(stopped.errors.size(), 1);
+	BOOST_CHECK_EQUAL(stopped.errors[0].index, 1);
+	BOOST_CHECK_EQUAL(stopped.errors[0].message, "odd");
+
+	BatchResult continued = callBatch(handle, args, continue_on_error);
+	BOOST_CHECK_EQUAL(continued.calls, 5);
+	BOOST_CHECK_EQUAL(continued.errors.size(), 2);
+
+	int seen = globals(f.state)["seen"];
+	BOOST_CHECK_EQUAL(seen, 4);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+#ifdef LBIND_STATISTICS
+BOOST_AUTO_TEST_CASE(boundary_statistics)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	registerFunction(f.state, LUA_RIDX_GLOBALS, "add", add_int);
+	registerFunction(f.state, LUA_RIDX_GLOBALS, "add", add_string);
+	registerFunction(f.state, LUA_RIDX_GLOBALS, "addone", addone);
+
+	BOOST_CHECK(!dostring(f.state, "for i = 1, 10 do addone(i) end; add('ab', 'cd'); function twice(x) return x * 2 end"));
+
+	LuaFunction<int(int)> twice(globals(f.state)["twice"]);
+	BOOST_CHECK_EQUAL(twice(4), 8);
+
+	Statistics s = getStatistics(f.state);
+	BOOST_CHECK_EQUAL(s.luaToC, 11);
+	BOOST_CHECK_EQUAL(s.cToLua, 1);
+	BOOST_CHECK_EQUAL(s.luaToCLatency.samples, 11);
+	BOOST_CHECK_EQUAL(s.cToLuaLatency.samples, 1);
+	BOOST_CHECK(s.converts >= 24);
+	BOOST_CHECK(s.convertedBytes >= 8);
+
+	std::map<std::string, FunctionStatistics> byName;
+	for (auto& fn : s.functions)
+	{
+		byName[fn.name] = fn;
+	}
+
+	BOOST_CHECK_EQUAL(byName["addone"].calls, 10);
+	BOOST_CHECK_EQUAL(byName["add"].calls, 1);
+
+	//The strings did not convert to integers, so the first overload missed.
+	BOOST_CHECK_EQUAL(byName["add"].overloadMisses, 1);
+
+	//The aggregate includes this state, and keeps its totals once it is closed.
+	Statistics before = getStatistics(nullptr);
+	BOOST_CHECK(before.luaToC >= 11);
+
+	{
+		StateFixture other;
+		registerFunction(other.state, LUA_RIDX_GLOBALS, "addone", addone);
+		BOOST_CHECK(!dostring(other.state, "addone(1)"));
+	}
+
+	Statistics after = getStatistics(nullptr);
+	BOOST_CHECK_EQUAL(after.luaToC, before.luaToC + 1);
+
+	resetStatistics(f.state);
+	BOOST_CHECK_EQUAL(getStatistics(f.state).luaToC, 0);
+	BOOST_CHECK(getStatistics(f.state).functions.empty());
+}
+
+BOOST_AUTO_TEST_CASE(latency_histogram)
+{
+	lbind::Histogram h;
+	h.record(0);
+	h.record(1);
+	h.record(3);
+	h.record(1000);
+
+	BOOST_CHECK_EQUAL(h.samples, 4);
+	BOOST_CHECK_EQUAL(h.totalNanoseconds, 1004);
+	BOOST_CHECK_EQUAL(h.counts[0], 2);
+	BOOST_CHECK_EQUAL(h.counts[1], 1);
+	BOOST_CHECK_EQUAL(h.counts[9], 1);
+	BOOST_CHECK_EQUAL(h.percentile(0.5), 2);
+	BOOST_CHECK_EQUAL(h.percentile(1.0), 1024);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(sampling_profiler)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	registerFunction(f.state, LUA_RIDX_GLOBALS, "slow", []()
+	{
+		volatile double x = 0;
+		for (int i = 0; i < 100000; ++i)
+		{
+			x = x + i;
+		}
+	});
+
+	BOOST_CHECK(!dostring(f.state, "function inner(n) local s = 0 for i = 1, n do s = s + i end slow() return s end\n"
+		"function outer() for i = 1, 50 do inner(2000) end end"));
+
+	Profiler profiler(f.state, std::chrono::microseconds(100));
+	profiler.start();
+
+	Profiler second(f.state);
+	BOOST_CHECK_THROW(second.start(), BindingError);
+
+	BOOST_CHECK(!dostring(f.state, "outer()"));
+	profiler.stop();
+
+	BOOST_CHECK(profiler.samples() > 10);
+
+	std::string folded = profiler.folded();
+	BOOST_CHECK(folded.find("outer [string") != std::string::npos);
+	BOOST_CHECK(folded.find(";inner [string") != std::string::npos);
+
+	//Time inside the bound function is charged to it, on top of its caller.
+	std::istringstream lines(folded);
+	std::string line;
+	boost::uint64_t slow = 0;
+	while (std::getline(lines, line))
+	{
+		if (line.find("inner") != std::string::npos && line.find(";[C++] slow ") != std::string::npos)
+		{
+			slow += boost::lexical_cast<boost::uint64_t>(line.substr(line.rfind(' ') + 1));
+		}
+	}
+
+	BOOST_CHECK(slow > 0);
+
+	//Stopped profilers leave the state alone.
+	size_t samples = profiler.samples();
+	BOOST_CHECK(!dostring(f.state, "outer()"));
+	BOOST_CHECK_EQUAL(profiler.samples(), samples);
+	BOOST_CHECK(lua_gethook(f.state) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(profiler_after_erroring_binding)
+{
+	using namespace lbind;
+	StateFixture f;
+
+	registerFunction(f.state, LUA_RIDX_GLOBALS, "fail", []()
+	{
+		throw LuaError("failed");
+	});
+
+	BOOST_CHECK(!dostring(f.state, "function spin() local s = 0 for i = 1, 2000000 do s = s + i end return s end"));
+
+	try
+	{
+		//Raised through Lua as an error or as the exception, depending on how Lua was built.
+		BOOST_CHECK(dostring(f.state, "fail()"));
+	}
+	catch (const LuaError&)
+	{}
+
+	BOOST_CHECK(Detail::getInternalState(f.state)->activeFunction.load() == nullptr);
+
+	Profiler profiler(f.state, std::chrono::microseconds(100));
+	profiler.start();
+
+	BOOST_CHECK(!dostring(f.state, "spin()"));
+	profiler.stop();
+
+	//Nothing after the error is charged to the binding that raised it.
+	BOOST_CHECK(profiler.samples() > 0);
+	BOOST_CHECK(profiler.folded().find("[C++] fail") == std::string::npos);
+}
+
 /*
 //COROUTINES work!
 BOOST_AUTO_TEST_CASE(coroutines_work)
@@ -320,4 +643,17 @@ BOOST_AUTO_TEST_CASE(coroutines_work)
 
 
 	thread.resume();
-}*/
\ No newline at end of file
+}*/
+
+BOOST_AUTO_TEST_CASE(bound_calls_do_not_allocate)
+{
+	StateFixture f;
+
+	lbind::registerFunction(f.state, LUA_RIDX_GLOBALS, "add", add_int);
+	lbind::Object loop = lbind::compile(f.state, "local a = 0 for i = 1, 100 do a = add(a, 1) end");
+
+	LBIND_EXPECT_ALLOCS(0, lbind::call<void>(loop));
+
+	lbind::Object add = lbind::globals(f.state)["add"];
+	LBIND_EXPECT_ALLOCS(0, lbind::call<int>(add, 1, 2));
+}
@@ -0,0 +1,98 @@
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include "fixtures.hpp"
+
+namespace
+{
+	size_t heapBytes(lua_State * state)
+	{
+		return static_cast<size_t>(lua_gc(state, LUA_GCCOUNT)) * 1024 + static_cast<size_t>(lua_gc(state, LUA_GCCOUNTB));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(gc_controller_paces_collection)
+{
+	using namespace lbind;
+
+	StateFixture f;
+	GcOptions options;
+	options.mode = GcOptions::Incremental;
+
+	{
+		GcController gc(f.state, options);
+		BOOST_CHECK(!lua_gc(f.state, LUA_GCISRUNNING));
+
+		//Nothing is freed while scripts run, however much garbage they make.
+		size_t before = heapBytes(f.state);
+		BOOST_CHECK(!dostring(f, "for i = 1, 20000 do local t = { i, tostring(i) } end"));
+		size_t grown = heapBytes(f.state);
+		BOOST_CHECK(grown > before + 1024 * 1024);
+
+		size_t collected = 0;
+		size_t cycles = 0;
+		for (int i = 0; i < 10000 && cycles < 2; ++i)
+		{
+			GcStep step = gc.stepFor(std::chrono::microseconds(100));
+			BOOST_CHECK(step.steps > 0);
+			BOOST_CHECK(step.longestPause <= step.elapsed);
+
+			collected += step.collected;
+			cycles += step.cycles;
+		}
+
+		BOOST_CHECK_EQUAL(cycles, 2);
+		BOOST_CHECK(heapBytes(f.state) < grown / 2);
+		BOOST_CHECK(collected > grown / 2);
+
+		BOOST_CHECK_EQUAL(gc.totals().collected, collected);
+		BOOST_CHECK_EQUAL(gc.totals().cycles, 2);
+	}
+
+	BOOST_CHECK(lua_gc(f.state, LUA_GCISRUNNING));
+}
+
+BOOST_AUTO_TEST_CASE(gc_controller_is_exclusive)
+{
+	using namespace lbind;
+
+	StateFixture f;
+	GcController gc(f.state);
+	BOOST_CHECK_THROW(GcController(f.state), BindingError);
+}
+
+BOOST_AUTO_TEST_CASE(gc_controller_outlives_close)
+{
+	using namespace lbind;
+
+	StateFixture f;
+	{
+		GcController gc(f.state);
+		lbind::close(f.state);
+	}
+
+	BOOST_CHECK(lua_gc(f.state, LUA_GCISRUNNING));
+}
+
+BOOST_AUTO_TEST_CASE(gc_controller_adapts_to_allocation_rate)
+{
+	using namespace lbind;
+
+	StateFixture f;
+	GcOptions options;
+	options.window = std::chrono::microseconds(0);
+	options.generationalRate = 1024 * 1024;
+	options.incrementalRate = 1024;
+
+	GcController gc(f.state, options);
+	BOOST_CHECK(!gc.generational());
+
+	BOOST_CHECK(!dostring(f, "for i = 1, 20000 do local t = { i, tostring(i) } end"));
+	gc.stepFor(std::chrono::microseconds(100));
+	BOOST_CHECK(gc.generational());
+	BOOST_CHECK(gc.allocationRate() >= options.generationalRate);
+
+	//Quiet for a while: nothing allocated between steps.
+	gc.stepFor(std::chrono::microseconds(100));
+	gc.stepFor(std::chrono::microseconds(100));
+	BOOST_CHECK(!gc.generational());
+}
@@ -0,0 +1,402 @@
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include "fixtures.hpp"
+#include "binddsl.hpp"
+
+using namespace lbind;
+
+namespace
+{
+	//The number of slots in the array part of the registry, which is where luaL_ref stores references.
+	size_t registrySize(lua_State * state)
+	{
+		return lua_rawlen(state, LUA_REGISTRYINDEX);
+	}
+
+	struct Holder
+	{
+		Object held;
+	};
+
+	Holder hold(Object o)
+	{
+		return Holder{ o };
+	}
+}
+
+BOOST_AUTO_TEST_CASE(object_releases_reference)
+{
+	StateFixture f;
+
+	{
+		Object warm = newtable(f.state);
+	}
+
+	size_t before = registrySize(f.state);
+	for (size_t i = 0; i < 1000; ++i)
+	{
+		Object t = newtable(f.state);
+		t["value"] = static_cast<int>(i);
+	}
+
+	BOOST_CHECK_EQUAL(registrySize(f.state), before);
+}
+
+BOOST_AUTO_TEST_CASE(object_copies_share_slot)
+{
+	StateFixture f;
+
+	Object second;
+	{
+		Object first = newtable(f.state);
+		first["value"] = 42;
+
+		second = first;
+		BOOST_CHECK_EQUAL(first.index(), second.index());
+	}
+
+	//The copy keeps the slot alive after the original is gone.
+	BOOST_CHECK_EQUAL(second.type(), LUA_TTABLE);
+	BOOST_CHECK_EQUAL(cast<int>(second["value"]), 42);
+
+	Object moved(std::move(second));
+	BOOST_CHECK_EQUAL(second.index(), LUA_NOREF);
+	BOOST_CHECK_EQUAL(cast<int>(moved["value"]), 42);
+}
+
+BOOST_AUTO_TEST_CASE(object_recycles_slots)
+{
+	StateFixture f;
+
+	int ref = 0;
+	{
+		Object t = newtable(f.state);
+		ref = t.index();
+	}
+
+	Object t = newtable(f.state);
+	BOOST_CHECK_EQUAL(t.index(), ref);
+}
+
+BOOST_AUTO_TEST_CASE(globals_and_nil_need_no_reference)
+{
+	StateFixture f;
+
+	size_t before = registrySize(f.state);
+
+	Object g = globals(f.state);
+	Object copy = g;
+	BOOST_CHECK_EQUAL(copy.index(), LUA_RIDX_GLOBALS);
+
+	Object missing = g["does_not_exist"];
+	BOOST_CHECK_EQUAL(missing.index(), LUA_REFNIL);
+	BOOST_CHECK_EQUAL(missing.type(), LUA_TNIL);
+
+	BOOST_CHECK_EQUAL(registrySize(f.state), before);
+}
+
+BOOST_AUTO_TEST_CASE(iterate_object)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "t = { a = 1, b = 2, c = 3.5 }"));
+
+	Object t = globals(f.state)["t"];
+
+	int top = lua_gettop(f.state);
+	size_t before = registrySize(f.state);
+
+	double sum = 0;
+	std::string keys;
+	for (auto entry : t)
+	{
+		BOOST_CHECK_EQUAL(entry.keyType(), LUA_TSTRING);
+		keys += entry.key<std::string_view>();
+		sum += entry.value<double>();
+	}
+
+	BOOST_CHECK_EQUAL(sum, 6.5);
+	BOOST_CHECK_EQUAL(keys.size(), 3);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+	BOOST_CHECK_EQUAL(registrySize(f.state), before);
+}
+
+BOOST_AUTO_TEST_CASE(iterate_stack_object)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "t = { 10, 20, 30 }"));
+
+	lua_getglobal(f.state, "t");
+	StackObject t(f.state, -1);
+
+	int top = lua_gettop(f.state);
+	int keys = 0;
+	int sum = 0;
+	for (auto entry : t)
+	{
+		keys += entry.key<int>();
+		sum += entry.value<int>();
+	}
+
+	BOOST_CHECK_EQUAL(keys, 6);
+	BOOST_CHECK_EQUAL(sum, 60);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+	lua_pop(f.state, 1);
+}
+
+BOOST_AUTO_TEST_CASE(iterate_break_restores_stack)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "t = { 1, 2, 3, 4 }"));
+
+	Object t = globals(f.state)["t"];
+	int top = lua_gettop(f.state);
+
+	for (auto entry : t)
+	{
+		if (entry.value<int>() == 2)
+		{
+			break;
+		}
+	}
+
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+
+	Object empty = newtable(f.state);
+	for ([[maybe_unused]] auto entry : empty)
+	{
+		BOOST_FAIL("Empty tables have no entries");
+	}
+
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+BOOST_AUTO_TEST_CASE(array_view_reads)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "a = { 1.5, 2.5, 3.5, 4.5 }"));
+
+	ArrayView<double> view(globals(f.state)["a"]);
+	BOOST_CHECK_EQUAL(view.size(), 4);
+
+	std::vector<double> values = view.toVector();
+	BOOST_CHECK_EQUAL(values.size(), 4);
+	BOOST_CHECK_EQUAL(values[0], 1.5);
+	BOOST_CHECK_EQUAL(values[3], 4.5);
+
+	double partial[2] = { 0, 0 };
+	BOOST_CHECK_EQUAL(view.copyTo(partial, 2), 2);
+	BOOST_CHECK_EQUAL(partial[1], 2.5);
+
+	BOOST_CHECK(!dostring(f, "b = { 1, 'two', 3 }"));
+	ArrayView<int> bad(globals(f.state)["b"]);
+	BOOST_CHECK_THROW(bad.toVector(), BadCast);
+}
+
+BOOST_AUTO_TEST_CASE(array_view_writes)
+{
+	StateFixture f;
+
+	std::vector<int> values = { 1, 2, 3, 4, 5 };
+	globals(f.state)["a"] = newarray(f.state, values);
+	BOOST_CHECK(!dostring(f, "n = #a; s = 0; for i, v in ipairs(a) do s = s + v end"));
+	BOOST_CHECK_EQUAL(cast<int>(globals(f.state)["n"]), 5);
+	BOOST_CHECK_EQUAL(cast<int>(globals(f.state)["s"]), 15);
+
+	//Shrinking clears the old tail.
+	ArrayView<int> view(globals(f.state)["a"]);
+	std::vector<int> fewer = { 7, 8 };
+	view.assign(fewer);
+	BOOST_CHECK(!dostring(f, "n = #a; third = a[3]"));
+	BOOST_CHECK_EQUAL(cast<int>(globals(f.state)["n"]), 2);
+	BOOST_CHECK_EQUAL(globals(f.state)["third"].operator Object().type(), LUA_TNIL);
+
+	lua_getglobal(f.state, "a");
+	ArrayView<int> stackView(StackObject(f.state, -1));
+	BOOST_CHECK_EQUAL(stackView.toVector()[1], 8);
+	lua_pop(f.state, 1);
+}
+
+BOOST_AUTO_TEST_CASE(chained_access)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "cfg = { server = { limits = { rps = 250 }, hosts = { 'a', 'b' } } }"));
+
+	Object cfg = globals(f.state)["cfg"];
+
+	int top = lua_gettop(f.state);
+	size_t before = registrySize(f.state);
+
+	int rps = cfg["server"]["limits"]["rps"];
+	std::string host = cfg["server"]["hosts"][2];
+	BOOST_CHECK_EQUAL(rps, 250);
+	BOOST_CHECK_EQUAL(host, "b");
+
+	cfg["server"]["limits"]["rps"] = 500;
+	rps = cfg["server"]["limits"]["rps"];
+	BOOST_CHECK_EQUAL(rps, 500);
+
+	//None of the levels above needed a reference.
+	BOOST_CHECK_EQUAL(registrySize(f.state), before);
+
+	cfg["server"]["limits"]["burst"] = cfg["server"]["limits"]["rps"];
+	BOOST_CHECK(!dostring(f, "burst = cfg.server.limits.burst"));
+	BOOST_CHECK_EQUAL(cast<int>(globals(f.state)["burst"]), 500);
+
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+BOOST_AUTO_TEST_CASE(chained_access_between_depths)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "cfg = { a = {}, n = 3, x = { y = { z = 'deep' } } }"));
+
+	Object cfg = globals(f.state)["cfg"];
+	int top = lua_gettop(f.state);
+
+	cfg["a"]["b"] = cfg["x"]["y"]["z"];
+	cfg["a"]["c"] = cfg["n"];
+	cfg["m"] = cfg["x"]["y"]["z"];
+	cfg["k"] = globals(f.state)["cfg"]["n"];
+
+	BOOST_CHECK(!dostring(f, "ok = cfg.a.b == 'deep' and cfg.a.c == 3 and cfg.m == 'deep' and cfg.k == 3"));
+	BOOST_CHECK(cast<bool>(globals(f.state)["ok"]));
+
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+BOOST_AUTO_TEST_CASE(chained_access_missing_levels)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "cfg = { server = 42 }"));
+
+	Object cfg = globals(f.state)["cfg"];
+	int top = lua_gettop(f.state);
+
+	Object missing = cfg["client"]["limits"]["rps"];
+	BOOST_CHECK_EQUAL(missing.type(), LUA_TNIL);
+
+	Object scalar = cfg["server"]["limits"];
+	BOOST_CHECK_EQUAL(scalar.type(), LUA_TNIL);
+
+	BOOST_CHECK_THROW(cfg["client"]["limits"]["rps"] = 5, BindingError);
+	BOOST_CHECK_THROW(cfg["server"]["limits"] = 5, BindingError);
+
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+BOOST_AUTO_TEST_CASE(interned_keys)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "entity = { position = 4.5, stats = { health = 10 } }"));
+
+	Key position(f.state, "position");
+	Key stats(f.state, "stats");
+	Key health(f.state, "health");
+
+	Object entity = globals(f.state)["entity"];
+	int top = lua_gettop(f.state);
+
+	double x = entity[position];
+	BOOST_CHECK_EQUAL(x, 4.5);
+
+	entity[position] = 6.0;
+	int h = entity[stats][health];
+	BOOST_CHECK_EQUAL(h, 10);
+
+	entity[stats][health] = 20;
+	BOOST_CHECK(!dostring(f, "a = entity.position; b = entity.stats.health"));
+	BOOST_CHECK_EQUAL(cast<double>(globals(f.state)["a"]), 6.0);
+	BOOST_CHECK_EQUAL(cast<int>(globals(f.state)["b"]), 20);
+
+	lua_getglobal(f.state, "entity");
+	StackObject stackEntity(f.state, -1);
+	double y = stackEntity[position];
+	BOOST_CHECK_EQUAL(y, 6.0);
+	lua_pop(f.state, 1);
+
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+}
+
+BOOST_AUTO_TEST_CASE(interned_keys_only_assign_to_tables)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "entity = { name = 'box', stats = 5 }"));
+
+	Key name(f.state, "name");
+	Key stats(f.state, "stats");
+	Key health(f.state, "health");
+
+	Object entity = globals(f.state)["entity"];
+	Object title = entity[name];
+	int top = lua_gettop(f.state);
+
+	BOOST_CHECK_THROW(title[health] = 10, BindingError);
+	BOOST_CHECK_THROW(entity[stats][health] = 10, BindingError);
+
+	//Userdata can be walked through, but not assigned to raw.
+	lua_getglobal(f.state, "entity");
+	lua_newuserdatauv(f.state, 16, 0);
+	lua_setfield(f.state, -2, "blob");
+	lua_pop(f.state, 1);
+
+	Key blob(f.state, "blob");
+	BOOST_CHECK_THROW(entity[blob][health] = 10, BindingError);
+
+	lua_getglobal(f.state, "entity");
+	lua_getfield(f.state, -1, "name");
+	StackObject stackTitle(f.state, -1);
+	BOOST_CHECK_THROW(stackTitle[health] = 10, BindingError);
+	lua_pop(f.state, 2);
+
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+	BOOST_CHECK_EQUAL(cast<int>(globals(f.state)["entity"]["stats"]), 5);
+}
+
+BOOST_AUTO_TEST_CASE(interned_keys_as_return_values)
+{
+	StateFixture f;
+
+	Key red(f.state, "Red");
+	lbind::registerFunction(f.state, LUA_RIDX_GLOBALS, "color", [&red]()
+	{
+		return red;
+	});
+
+	BOOST_CHECK(!dostring(f, "c = color()"));
+	BOOST_CHECK_EQUAL(cast<std::string>(globals(f.state)["c"]), "Red");
+}
+
+BOOST_AUTO_TEST_CASE(iteration_does_not_allocate)
+{
+	StateFixture f;
+	BOOST_CHECK(!dostring(f, "t = { 1, 2, 3, x = 4, y = 5 }"));
+
+	Object t = globals(f.state)["t"];
+
+	double sum = 0;
+	LBIND_EXPECT_ALLOCS(0, for (auto entry : t) { sum += entry.value<double>(); });
+	BOOST_CHECK_EQUAL(sum, 30);
+
+	LBIND_EXPECT_ALLOCS(0, sum = t["x"]);
+	LBIND_EXPECT_ALLOCS(0, sum = t[1]);
+}
+
+BOOST_AUTO_TEST_CASE(objects_outlive_close)
+{
+	StateFixture f;
+	module(f.state)
+		.class_<Holder>("Holder")
+		.endclass()
+		.def("hold", hold)
+	.end();
+
+	//Lua owns h, so lua_close destroys its Object after lbind::close.
+	BOOST_CHECK(!dostring(f, "h = hold({})"));
+
+	{
+		Object kept = newtable(f.state);
+		lbind::close(f.state);
+	}
+
+	BOOST_CHECK(!Detail::getInternalState(f.state));
+}
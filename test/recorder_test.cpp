@@ -0,0 +1,221 @@
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include "fixtures.hpp"
+#include "binddsl.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	struct TraceFile
+	{
+		TraceFile()
+			:path((std::filesystem::temp_directory_path() / "lbind_recorder_test.lbtrace").string())
+		{
+			std::filesystem::remove(path);
+		}
+
+		~TraceFile()
+		{
+			std::filesystem::remove(path);
+		}
+
+		std::string path;
+	};
+
+	int noted = 0;
+	int picked = 0;
+	int added = 0;
+	int ticks = 0;
+
+	struct Tally
+	{
+		explicit Tally(int start)
+			:total(start)
+		{}
+
+		void add(int n)
+		{
+			total += n;
+			added += n;
+		}
+
+		int total;
+	};
+
+	void note(int n)
+	{
+		noted += n;
+	}
+
+	void pickInt(int n)
+	{
+		picked += n;
+	}
+
+	void pickString(const std::string& s)
+	{
+		picked += static_cast<int>(s.size());
+	}
+
+	void tick()
+	{
+		ticks++;
+	}
+
+	void bind(lua_State * state)
+	{
+		using namespace lbind;
+
+		module(state)
+			.class_<Tally>("Tally")
+				.constructor<int>()
+				.def("add", &Tally::add)
+			.endclass()
+			.def("note", note)
+			.def("pick", pickInt)
+			.def("pick", pickString)
+			.def("tick", tick)
+		.end();
+	}
+
+	void reset()
+	{
+		noted = picked = added = ticks = 0;
+	}
+
+	//Loaded under a fixed chunk name, so its functions have the same name in every state.
+	void load(lua_State * state, const char * script)
+	{
+		BOOST_REQUIRE(luaL_loadbuffer(state, script, std::strlen(script), "=game") == LUA_OK);
+		BOOST_REQUIRE(lua_pcall(state, 0, 0, 0) == LUA_OK);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(recorder_replays_bound_calls)
+{
+	using namespace lbind;
+	TraceFile trace;
+
+	{
+		StateFixture f;
+		bind(f.state);
+		reset();
+
+		Recorder recorder(f.state, trace.path);
+		recorder.start();
+		BOOST_CHECK(!dostring(f, "t = Tally(1) t:add(2) note(3) note(4) pick(5) pick('xy')"));
+		recorder.stop();
+
+		//Not recorded.
+		BOOST_CHECK(!dostring(f, "note(100)"));
+
+		BOOST_CHECK_EQUAL(recorder.calls(), 6);
+		BOOST_CHECK_EQUAL(noted, 107);
+	}
+
+	Replayer replayer(trace.path);
+	BOOST_CHECK_EQUAL(replayer.calls(), 6);
+
+	StateFixture f;
+	bind(f.state);
+	BOOST_CHECK(!dostring(f, "stand_in = Tally(0)"));
+	reset();
+
+	replayer.substitute("Tally", [](lua_State * s) { lua_getglobal(s, "stand_in"); });
+
+	int top = lua_gettop(f.state);
+	ReplayResult result = replayer.replay(f.state);
+	BOOST_CHECK_EQUAL(lua_gettop(f.state), top);
+
+	BOOST_CHECK_EQUAL(result.calls, 6);
+	BOOST_CHECK_EQUAL(result.failed, 0);
+	BOOST_CHECK_EQUAL(result.skipped, 0);
+	BOOST_CHECK(result.recorded.count() > 0);
+
+	BOOST_CHECK_EQUAL(noted, 7);
+	BOOST_CHECK_EQUAL(picked, 7);
+	BOOST_CHECK_EQUAL(added, 2);
+}
+
+BOOST_AUTO_TEST_CASE(recorder_replays_outermost_calls)
+{
+	using namespace lbind;
+	TraceFile trace;
+
+	const char * script = "function update(n) for i = 1, n do tick() end end";
+
+	{
+		StateFixture f;
+		bind(f.state);
+		load(f.state, script);
+
+		Recorder recorder(f.state, trace.path);
+		recorder.start();
+		call<void>(globals(f.state)["update"], 3);
+		recorder.stop();
+
+		//The call into update, and the ticks it made.
+		BOOST_CHECK_EQUAL(recorder.calls(), 4);
+	}
+
+	StateFixture f;
+	bind(f.state);
+	load(f.state, script);
+
+	Replayer replayer(trace.path);
+
+	//Without update, the ticks it made are replayed on their own.
+	reset();
+	ReplayResult direct = replayer.replay(f.state);
+	BOOST_CHECK_EQUAL(direct.calls, 3);
+	BOOST_CHECK_EQUAL(direct.skipped, 1);
+	BOOST_CHECK_EQUAL(ticks, 3);
+
+	//With it, update makes them again.
+	reset();
+	replayer.map("game:1", globals(f.state)["update"]);
+	ReplayResult mapped = replayer.replay(f.state);
+	BOOST_CHECK_EQUAL(mapped.calls, 1);
+	BOOST_CHECK_EQUAL(mapped.skipped, 0);
+	BOOST_CHECK_EQUAL(ticks, 3);
+}
+
+BOOST_AUTO_TEST_CASE(recorder_rejects_misuse)
+{
+	using namespace lbind;
+	TraceFile trace;
+	StateFixture f;
+
+	Recorder first(f.state, trace.path);
+	first.start();
+
+	Recorder second(f.state, trace.path + ".second");
+	BOOST_CHECK_THROW(second.start(), BindingError);
+	first.stop();
+
+	{
+		std::ofstream out(trace.path, std::ios::binary | std::ios::trunc);
+		out << "not a trace";
+	}
+
+	BOOST_CHECK_THROW(Replayer replayer(trace.path), BindingError);
+	BOOST_CHECK_THROW(Replayer replayer(trace.path + ".missing"), BindingError);
+}
+
+BOOST_AUTO_TEST_CASE(recorder_outlives_close)
+{
+	using namespace lbind;
+	TraceFile trace;
+	StateFixture f;
+
+	{
+		Recorder recorder(f.state, trace.path);
+		recorder.start();
+		lbind::close(f.state);
+	}
+
+	BOOST_CHECK(!Detail::getInternalState(f.state));
+}
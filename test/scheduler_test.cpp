@@ -0,0 +1,137 @@
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include "fixtures.hpp"
+#include "binddsl.hpp"
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	lbind::Scheduler * scheduler = nullptr;
+
+	//Futures of the jobs submitted by fanout, from inside a job.
+	std::mutex fannedLock;
+	std::vector<std::future<int>> fanned;
+
+	int twice(int n)
+	{
+		return n * 2;
+	}
+
+	int slow(int n)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return n;
+	}
+
+	void fanout(int n)
+	{
+		std::lock_guard<std::mutex> held(fannedLock);
+		for (int i = 0; i < n; ++i)
+		{
+			fanned.push_back(scheduler->submit<int>("slow", i));
+		}
+	}
+
+	void setup(lua_State * state)
+	{
+		lbind::module(state)
+			.def("twice", twice)
+			.def("slow", slow)
+			.def("fanout", fanout)
+		.end();
+
+		BOOST_REQUIRE(!dostring(state,
+			"function add(a, b) return a + b end "
+			"function doubled(n) return twice(n) end "
+			"function broken() error('boom') end"));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_runs_jobs_on_bound_states)
+{
+	lbind::SchedulerOptions options;
+	options.workers = 4;
+
+	lbind::Scheduler s(setup, options);
+	BOOST_CHECK_EQUAL(s.workers(), 4);
+
+	std::vector<std::future<int>> added;
+	std::vector<std::future<int>> doubled;
+	for (int i = 0; i < 1000; ++i)
+	{
+		added.push_back(s.submit<int>("add", i, 1));
+		doubled.push_back(s.submit<int>("doubled", i));
+	}
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		BOOST_CHECK_EQUAL(added[i].get(), i + 1);
+		BOOST_CHECK_EQUAL(doubled[i].get(), i * 2);
+	}
+
+	BOOST_CHECK_EQUAL(s.pending(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_returns_errors_through_futures)
+{
+	lbind::SchedulerOptions options;
+	options.workers = 2;
+
+	lbind::Scheduler s(setup, options);
+
+	std::future<void> broken = s.submit<void>("broken");
+	std::future<int> missing = s.submit<int>("missing", 1);
+	BOOST_CHECK_THROW(broken.get(), lbind::LuaError);
+	BOOST_CHECK_THROW(missing.get(), lbind::LuaError);
+
+	//The states are left usable.
+	BOOST_CHECK_EQUAL(s.submit<int>("add", 2, 3).get(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_steals_jobs_submitted_from_a_job)
+{
+	lbind::SchedulerOptions options;
+	options.workers = 2;
+
+	lbind::Scheduler s(setup, options);
+	scheduler = &s;
+
+	//Queued on the worker running fanout, so the other one only gets them by stealing.
+	s.submit<void>("fanout", 50).get();
+
+	std::lock_guard<std::mutex> held(fannedLock);
+	for (int i = 0; i < 50; ++i)
+	{
+		BOOST_CHECK_EQUAL(fanned[i].get(), i);
+	}
+
+	BOOST_CHECK(s.stolen() > 0);
+
+	fanned.clear();
+	scheduler = nullptr;
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_finishes_jobs_before_closing)
+{
+	lbind::SchedulerOptions options;
+	options.workers = 2;
+
+	std::vector<std::future<int>> results;
+	{
+		lbind::Scheduler s(setup, options);
+		for (int i = 0; i < 20; ++i)
+		{
+			results.push_back(s.submit<int>("slow", i));
+		}
+	}
+
+	for (int i = 0; i < 20; ++i)
+	{
+		BOOST_CHECK_EQUAL(results[i].get(), i);
+	}
+}
@@ -0,0 +1,135 @@
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include "fixtures.hpp"
+
+#include <memory>
+
+BOOST_AUTO_TEST_CASE(newstate_tracks_memory)
+{
+	using namespace lbind;
+
+	lua_State * state = newstate();
+	MemoryUsage before = memoryUsage(state);
+	BOOST_CHECK(before.live > 0);
+	BOOST_CHECK(before.peak >= before.live);
+	BOOST_CHECK_EQUAL(before.limit, 0);
+
+	BOOST_CHECK(!dostring(state, "t = {} for i = 1, 10000 do t[i] = tostring(i) end"));
+
+	MemoryUsage grown = memoryUsage(state);
+	BOOST_CHECK(grown.live > before.live);
+	BOOST_CHECK(grown.reserved >= grown.live);
+
+	BOOST_CHECK(!dostring(state, "t = nil collectgarbage()"));
+
+	MemoryUsage collected = memoryUsage(state);
+	BOOST_CHECK(collected.live < grown.live);
+	BOOST_CHECK(collected.peak >= grown.live);
+
+	closestate(state);
+}
+
+BOOST_AUTO_TEST_CASE(newstate_enforces_limit)
+{
+	using namespace lbind;
+
+	StateOptions options;
+	options.memoryLimit = 512 * 1024;
+
+	lua_State * state = newstate(options);
+
+	const char * error = dostring(state, "t = {} for i = 1, 1000000 do t[i] = 'entry' .. i end");
+	BOOST_REQUIRE(error);
+	BOOST_CHECK(std::string(error).find("not enough memory") != std::string::npos);
+
+	MemoryUsage usage = memoryUsage(state);
+	BOOST_CHECK(usage.refused > 0);
+	BOOST_CHECK(usage.peak <= options.memoryLimit);
+
+	//The state is still usable once memory is freed. Even compiling a chunk needs memory, so free it from C.
+	lua_settop(state, 0);
+	lua_pushnil(state);
+	lua_setglobal(state, "t");
+	lua_gc(state, LUA_GCCOLLECT);
+
+	BOOST_CHECK(!dostring(state, "x = 1 + 1"));
+	int x = globals(state)["x"];
+	BOOST_CHECK_EQUAL(x, 2);
+
+	//Raising the limit lets the same script through.
+	setMemoryLimit(state, 0);
+	BOOST_CHECK(!dostring(state, "t = {} for i = 1, 100000 do t[i] = 'entry' .. i end"));
+
+	closestate(state);
+}
+
+BOOST_AUTO_TEST_CASE(newstate_shrinks_under_limit)
+{
+	using namespace lbind;
+
+	lua_State * state = newstate();
+
+	void * ud = nullptr;
+	lua_Alloc allocate = lua_getallocf(state, &ud);
+
+	//Across size classes, and from malloc'd blocks back into the arena.
+	void * small = allocate(ud, nullptr, LUA_TSTRING, 200);
+	void * large = allocate(ud, nullptr, LUA_TSTRING, 4096);
+	void * larger = allocate(ud, nullptr, LUA_TSTRING, 8192);
+	BOOST_REQUIRE(small && large && larger);
+
+	//Nothing can grow from here, but Lua assumes shrinking always works.
+	MemoryUsage capped = memoryUsage(state);
+	setMemoryLimit(state, capped.live);
+
+	small = allocate(ud, small, 200, 20);
+	large = allocate(ud, large, 4096, 100);
+	larger = allocate(ud, larger, 8192, 1024);
+	BOOST_CHECK(small && large && larger);
+	BOOST_CHECK_EQUAL(memoryUsage(state).live, capped.live - 180 - 3996 - 7168);
+
+	BOOST_CHECK(!allocate(ud, small, 20, 64 * 1024));
+	BOOST_CHECK_EQUAL(memoryUsage(state).refused, 1);
+
+	allocate(ud, small, 20, 0);
+	allocate(ud, large, 100, 0);
+	allocate(ud, larger, 1024, 0);
+
+	setMemoryLimit(state, 0);
+	closestate(state);
+}
+
+BOOST_AUTO_TEST_CASE(memory_usage_of_other_states)
+{
+	StateFixture f;
+	lbind::MemoryUsage usage = lbind::memoryUsage(f.state);
+	BOOST_CHECK_EQUAL(usage.live, 0);
+	BOOST_CHECK_EQUAL(usage.peak, 0);
+}
+
+BOOST_AUTO_TEST_CASE(close_destroys_binding_metadata)
+{
+	using namespace lbind;
+
+	auto token = std::make_shared<int>(0);
+	{
+		StateFixture f;
+
+		registerFunction(f.state, LUA_RIDX_GLOBALS, "touch", [token](int n)
+		{
+			*token += n;
+		});
+
+		//Overloading wraps the first function, both must still be destroyed.
+		registerFunction(f.state, LUA_RIDX_GLOBALS, "touch", [token]()
+		{
+			(*token)++;
+		});
+
+		BOOST_CHECK(!dostring(f.state, "touch() touch(2)"));
+		BOOST_CHECK_EQUAL(*token, 3);
+		BOOST_CHECK(token.use_count() > 1);
+	}
+
+	BOOST_CHECK_EQUAL(token.use_count(), 1);
+}
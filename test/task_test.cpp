@@ -0,0 +1,215 @@
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/unit_test.hpp>
+#include "fixtures.hpp"
+#include "binddsl.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace
+{
+	lbind::EventLoop * running = nullptr;
+
+	//Runs as soon as it is called, until it first suspends. Whatever it throws is kept in failure.
+	std::exception_ptr failure;
+
+	struct Detached
+	{
+		struct promise_type
+		{
+			Detached get_return_object()
+			{
+				return Detached();
+			}
+
+			std::suspend_never initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void return_void()
+			{}
+
+			void unhandled_exception()
+			{
+				failure = std::current_exception();
+			}
+		};
+	};
+
+	//Completed by the loop on its next turn.
+	lbind::Async<int> later(int n)
+	{
+		lbind::Async<int> result;
+		running->post([result, n]() { result.resolve(n); });
+		return result;
+	}
+
+	struct TaskFixture : StateFixture
+	{
+		TaskFixture()
+			:loop(state)
+		{
+			lbind::module(state)
+				.def("later", later)
+			.end();
+
+			BOOST_REQUIRE(!dostring(state,
+				"function add(a, b) return a + b end "
+				"function handle(n) return later(n) * 2 end "
+				"function broken() later(1) error('boom') end "
+				"function word() later(1) return 'abc' end "
+				"function count(n) for i = 1, n do coroutine.yield(later(i)) end return 'done' end"));
+
+			running = &loop;
+			failure = nullptr;
+		}
+
+		~TaskFixture()
+		{
+			running = nullptr;
+		}
+
+		lbind::Object global(const char * name)
+		{
+			return lbind::globals(state)[name];
+		}
+
+		lbind::EventLoop loop;
+	};
+
+	Detached sum(lbind::EventLoop& loop, lbind::Object f, int a, int b, int& out)
+	{
+		out = co_await lbind::Task<int>(loop, f, a, b);
+	}
+
+	Detached handle(lbind::EventLoop& loop, lbind::Object f, int n, int& out)
+	{
+		out = co_await lbind::Task<int>(loop, f, n);
+	}
+
+	Detached collect(lbind::EventLoop& loop, lbind::Object f, int n, std::vector<int>& out)
+	{
+		lbind::Generator<int> values(loop, f, n);
+		while (boost::optional<int> value = co_await values.next())
+		{
+			out.push_back(*value);
+		}
+
+		out.push_back(-1);
+	}
+
+	Detached first(lbind::EventLoop& loop, lbind::Object f, int& out)
+	{
+		lbind::Generator<int> values(loop, f, 100);
+		out = *co_await values.next();
+	}
+
+	Detached convert(lbind::EventLoop& loop, lbind::Object f, bool& out)
+	{
+		try
+		{
+			co_await lbind::Task<int>(loop, f);
+		}
+		catch (const lbind::BadCast&)
+		{
+			out = true;
+		}
+	}
+
+	Detached fail(lbind::EventLoop& loop, lbind::Object f, std::string& out)
+	{
+		try
+		{
+			co_await lbind::Task<void>(loop, f);
+		}
+		catch (const lbind::LuaError& e)
+		{
+			out = e.what();
+		}
+	}
+}
+
+BOOST_FIXTURE_TEST_CASE(task_returns_without_suspending, TaskFixture)
+{
+	int out = 0;
+	sum(loop, global("add"), 1, 2, out);
+
+	//The function never suspended, so neither did the coroutine.
+	BOOST_CHECK_EQUAL(out, 3);
+	BOOST_CHECK_EQUAL(loop.coroutines(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(tasks_interleave_on_one_thread, TaskFixture)
+{
+	const int count = 1000;
+	std::vector<int> out(count, 0);
+
+	for (int i = 0; i < count; ++i)
+	{
+		handle(loop, global("handle"), i, out[i]);
+	}
+
+	//All of them are waiting on their Async.
+	BOOST_CHECK_EQUAL(loop.coroutines(), count);
+	BOOST_CHECK_EQUAL(out[count - 1], 0);
+
+	loop.run();
+	BOOST_CHECK(!failure);
+	BOOST_CHECK_EQUAL(loop.coroutines(), 0);
+
+	for (int i = 0; i < count; ++i)
+	{
+		BOOST_CHECK_EQUAL(out[i], i * 2);
+	}
+}
+
+BOOST_FIXTURE_TEST_CASE(task_throws_lua_errors, TaskFixture)
+{
+	std::string error;
+	fail(loop, global("broken"), error);
+	loop.run();
+
+	BOOST_CHECK(error.find("boom") != std::string::npos);
+	BOOST_CHECK_EQUAL(loop.coroutines(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(task_throws_bad_results, TaskFixture)
+{
+	bool thrown = false;
+	convert(loop, global("word"), thrown);
+	loop.run();
+
+	BOOST_CHECK(thrown);
+	BOOST_CHECK(!failure);
+	BOOST_CHECK_EQUAL(loop.coroutines(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(generator_gives_yielded_values, TaskFixture)
+{
+	std::vector<int> out;
+	collect(loop, global("count"), 3, out);
+	loop.run();
+
+	BOOST_CHECK(!failure);
+	std::vector<int> expected = { 1, 2, 3, -1 };
+	BOOST_CHECK_EQUAL_COLLECTIONS(out.begin(), out.end(), expected.begin(), expected.end());
+}
+
+BOOST_FIXTURE_TEST_CASE(generator_closes_function_when_destroyed, TaskFixture)
+{
+	int out = 0;
+	first(loop, global("count"), out);
+	loop.run();
+
+	//The generator went away after the first value, with the function still in its loop.
+	BOOST_CHECK_EQUAL(out, 1);
+	BOOST_CHECK_EQUAL(loop.coroutines(), 0);
+}